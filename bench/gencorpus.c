@@ -0,0 +1,328 @@
+/*
+  F
+    x`}[NpID3v2.3t@C𐶐
+    seedłΏɓt@C
+
+    gencorpus [option] DIR
+      -n NUM   : t@C (default 200)
+      -s SEED  : ̎ (default 1)
+      -f NUM   : APICȊÕt[ (default 8)
+      -a BYTE  : APIC̉摜TCY (default 65536, }50%ł΂)
+      -m NUM   : APICt[ (default 1)
+      -c PCT   : APICMIME "ima\0ge/jpeg" ɂm (default 30)
+      -p PCT   : 2ڈȍ~APIC1ڂƓ^Cvɂm (default 30)
+      -u PCT   : 2ڈȍ~APIC1ڂƓ摜ɂm (default 0)
+      -x PCT   : gwb_tm (default 20)
+      -P BYTE  : padding̈̃TCY (default 2048)
+      -A BYTE  : f[^̃TCY (default 1048576)
+
+  쐬ҁ@@Fgbm
+*/
+
+
+/****************************************************/
+/*                     include                      */
+/****************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h> // getopt
+#include <errno.h>
+#include <sys/stat.h> // mkdir
+
+
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+#define RET_OK 0
+#define RET_ERROR -1
+
+#define ID3_HEADER_SIZE 10
+#define ID3_FRAME_SIZE 10
+#define ID3_EXTHEADER_SIZE 10
+#define ID3_TAG_MAXSIZE 0x0FFFFFFF
+#define FLAG_EXT 0x40
+
+#define PICTYPE_FRONT 0x03
+#define PICTURE_TYPE_NUM 0x15
+
+#define TEXT_FRAME_MAXSIZE 256
+#define MP3_FRAME_SIZE 418          // 128kbps 44.1kHz
+
+#define GEN_BUF_SIZE (64 * 1024)
+
+
+
+/****************************************************/
+/*                      struct                      */
+/****************************************************/
+
+/* GENoption ****************************
+   t@C̓e
+****************************************/
+typedef struct genoption{
+	int num;
+	unsigned long long seed;
+	int frames;
+	unsigned int apicsize;
+	int apics;
+	int corrupt;       // %
+	int duplicate;     // %
+	int same;          // %
+	int ext;           // %
+	unsigned int padding;
+	unsigned long long audio;
+}GENOPTION;
+
+
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+static unsigned long long next_rand(unsigned long long *state);
+static void put_be32(unsigned char *p, unsigned int n);
+static void fill_rand(unsigned char *buf, size_t n, unsigned long long *state);
+static unsigned char *put_frame(unsigned char *p, const char *id, unsigned int size);
+static int write_corpus_file(const char *path, const GENOPTION *opt, unsigned long long *state);
+
+
+
+/****************************************************/
+/*                    Process                       */
+/****************************************************/
+
+/* main *********************************/
+int main(int argc, char *argv[]) {
+	GENOPTION opt;
+	unsigned long long state;
+	char path[FILENAME_MAX];
+	int c, i;
+
+	opt.num = 200;
+	opt.seed = 1;
+	opt.frames = 8;
+	opt.apicsize = 64 * 1024;
+	opt.apics = 1;
+	opt.corrupt = 30;
+	opt.duplicate = 30;
+	opt.same = 0;
+	opt.ext = 20;
+	opt.padding = 2048;
+	opt.audio = 1024 * 1024;
+
+	while ((c = getopt(argc, argv, "n:s:f:a:m:c:p:u:x:P:A:")) != -1) {
+		switch (c) {
+		case 'n': opt.num = atoi(optarg); break;
+		case 's': opt.seed = strtoull(optarg, NULL, 0); break;
+		case 'f': opt.frames = atoi(optarg); break;
+		case 'a': opt.apicsize = strtoul(optarg, NULL, 0); break;
+		case 'm': opt.apics = atoi(optarg); break;
+		case 'c': opt.corrupt = atoi(optarg); break;
+		case 'p': opt.duplicate = atoi(optarg); break;
+		case 'u': opt.same = atoi(optarg); break;
+		case 'x': opt.ext = atoi(optarg); break;
+		case 'P': opt.padding = strtoul(optarg, NULL, 0); break;
+		case 'A': opt.audio = strtoull(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "Usage: %s [-n num] [-s seed] [-f frames] [-a apicsize] [-m apics] [-c corrupt%%] [-p duplicate%%] [-u same%%] [-x ext%%] [-P padding] [-A audiosize] DIR\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind + 1 != argc) {
+		fprintf(stderr, "Usage: %s [option] DIR\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (mkdir(argv[optind], 0777) && (errno != EEXIST)) {
+		fprintf(stderr, "mkdir error : %s\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	// ŏ1񂵂0ȊȌԂɂ
+	state = opt.seed * 0x9E3779B97F4A7C15ULL + 1;
+	for (i = 0; i < opt.num; i++) {
+		if (FILENAME_MAX <= snprintf(path, FILENAME_MAX, "%s/c%05d.mp3", argv[optind], i)) return EXIT_FAILURE;
+		if (write_corpus_file(path, &opt, &state)) {
+			fprintf(stderr, "write error : %s\n", path);
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+
+/* next_rand ****************************
+   xorshift64*
+****************************************/
+static unsigned long long next_rand(unsigned long long *state) {
+	unsigned long long x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+
+/* put_be32 *****************************/
+static void put_be32(unsigned char *p, unsigned int n) {
+	p[0] = (n >> 24) & 0xFF;
+	p[1] = (n >> 16) & 0xFF;
+	p[2] = (n >> 8) & 0xFF;
+	p[3] = n & 0xFF;
+}
+
+
+/* fill_rand ****************************
+   nbyte𗐐Ŗ߂
+   (0FFoȂ悤ɂApadding⓯MƍȂ)
+****************************************/
+static void fill_rand(unsigned char *buf, size_t n, unsigned long long *state) {
+	unsigned long long r = 0;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if ((i & 7) == 0) r = next_rand(state);
+		buf[i] = (unsigned char)(1 + (r & 0xFF) % 0xFE);
+		r >>= 8;
+	}
+}
+
+
+/* put_frame ****************************
+   t[wb_f[^̐擪Ԃ
+****************************************/
+static unsigned char *put_frame(unsigned char *p, const char *id, unsigned int size) {
+	memcpy(p, id, 4);
+	put_be32(p + 4, size);
+	p[8] = 0;
+	p[9] = 0;
+	return p + ID3_FRAME_SIZE;
+}
+
+
+/* write_corpus_file ********************
+   t@C1쐬
+   ߂lF0 G[-1
+****************************************/
+static int write_corpus_file(const char *path, const GENOPTION *opt, unsigned long long *state) {
+	static const char *textid[] = {"TIT2", "TPE1", "TALB", "TRCK", "TYER", "TCON", "COMM", "PRIV"};
+	static const char mime[] = "image/jpeg";
+	static const char badmime[] = "ima\0ge/jpeg";
+	unsigned char *tag, *p, *data;
+	unsigned char *first = NULL;
+	unsigned char buf[GEN_BUF_SIZE];
+	unsigned long long left;
+	unsigned int size, apicsize, tagsize, n, firstsize = 0;
+	int i, ext, same, pictype, firsttype = PICTYPE_FRONT;
+	FILE *fp;
+
+	// ^Ö̍őTCYς
+	size = ID3_HEADER_SIZE + ID3_EXTHEADER_SIZE + opt->padding;
+	size += opt->frames * (ID3_FRAME_SIZE + TEXT_FRAME_MAXSIZE);
+	size += opt->apics * (ID3_FRAME_SIZE + sizeof(badmime) + 3 + opt->apicsize + opt->apicsize / 2);
+	tag = calloc(1, size);
+	if (tag == NULL) return RET_ERROR;
+
+	ext = (int)(next_rand(state) % 100) < opt->ext;
+	p = tag + ID3_HEADER_SIZE;
+	if (ext) p += ID3_EXTHEADER_SIZE;
+
+	// eLXgt[
+	for (i = 0; i < opt->frames; i++) {
+		n = 1 + next_rand(state) % (TEXT_FRAME_MAXSIZE - 1);
+		data = put_frame(p, textid[i % (sizeof(textid) / sizeof(textid[0]))], n);
+		data[0] = 0; // ISO-8859-1
+		fill_rand(data + 1, n - 1, state);
+		p = data + n;
+	}
+
+	// APICt[
+	for (i = 0; i < opt->apics; i++) {
+		apicsize = opt->apicsize / 2 + (opt->apicsize ? next_rand(state) % (opt->apicsize + 1) : 0);
+		if (i == 0) pictype = firsttype;
+		else if ((int)(next_rand(state) % 100) < opt->duplicate) pictype = firsttype;
+		else pictype = (firsttype + i) % PICTURE_TYPE_NUM;
+
+		// -u 0ł͗gȂ (corpusςȂ)
+		same = (i > 0) && (opt->same > 0) && ((int)(next_rand(state) % 100) < opt->same);
+		if (same) apicsize = firstsize;
+
+		if ((int)(next_rand(state) % 100) < opt->corrupt) {
+			n = 1 + sizeof(badmime) + 2 + apicsize;
+			data = put_frame(p, "APIC", n);
+			memcpy(data + 1, badmime, sizeof(badmime));
+			data += 1 + sizeof(badmime);
+		}
+		else {
+			n = 1 + sizeof(mime) + 2 + apicsize;
+			data = put_frame(p, "APIC", n);
+			memcpy(data + 1, mime, sizeof(mime));
+			data += 1 + sizeof(mime);
+		}
+		p[ID3_FRAME_SIZE] = 0; // encode
+		data[0] = pictype;
+		data[1] = 0;           // description
+		if (same) memcpy(data + 2, first, apicsize);
+		else fill_rand(data + 2, apicsize, state);
+		if (i == 0) {
+			first = data + 2;
+			firstsize = apicsize;
+		}
+		p = data + 2 + apicsize;
+	}
+
+	// padding (calloc0ߍς)
+	p += opt->padding;
+	tagsize = p - tag;
+	if (tagsize - ID3_HEADER_SIZE > ID3_TAG_MAXSIZE) {
+		free(tag);
+		return RET_ERROR;
+	}
+
+	// wb_
+	memcpy(tag, "ID3", 3);
+	tag[3] = 0x03;
+	tag[4] = 0x00;
+	tag[5] = ext ? FLAG_EXT : 0;
+	n = tagsize - ID3_HEADER_SIZE;
+	tag[6] = (n >> 21) & 0x7F;
+	tag[7] = (n >> 14) & 0x7F;
+	tag[8] = (n >> 7) & 0x7F;
+	tag[9] = n & 0x7F;
+	if (ext) {
+		put_be32(tag + ID3_HEADER_SIZE, 6);
+		tag[ID3_HEADER_SIZE + 4] = 0;
+		tag[ID3_HEADER_SIZE + 5] = 0;
+		put_be32(tag + ID3_HEADER_SIZE + 6, opt->padding);
+	}
+
+	fp = fopen(path, "wb");
+	if (fp == NULL) {
+		free(tag);
+		return RET_ERROR;
+	}
+	if (1 != fwrite(tag, tagsize, 1, fp)) goto WRITE_CORPUS_FILE_ERROR;
+	free(tag);
+	tag = NULL;
+
+	// f[^ (MPEGt[̓MԊuœ)
+	for (left = opt->audio; left > 0; left -= n) {
+		n = (left > GEN_BUF_SIZE) ? GEN_BUF_SIZE : (unsigned int)left;
+		fill_rand(buf, n, state);
+		for (i = 0; i + 1 < (int)n; i += MP3_FRAME_SIZE) {
+			buf[i] = 0xFF;
+			buf[i + 1] = 0xFB;
+		}
+		if (n != fwrite(buf, 1, n, fp)) goto WRITE_CORPUS_FILE_ERROR;
+	}
+
+	return fclose(fp) ? RET_ERROR : RET_OK;
+
+  WRITE_CORPUS_FILE_ERROR:
+	free(tag);
+	fclose(fp);
+	return RET_ERROR;
+}
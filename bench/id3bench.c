@@ -0,0 +1,435 @@
+/*
+  F
+    id3tag.c̏Ԃv
+    DIR*.mp3ΏۂɁAȉ^u؂ŏo͂
+      parse_id3_tag       : ̃^Owb_ǂݑ
+      get_id3_repair_size : t[ꗗ쐬肷
+      repair_id3_tag      : CKvȃt@Cꎞt@C֏o
+      cli                 : -xŎw肵R}hDIR̃Rs[Ɏs
+
+    id3bench [-r] [-d FRAMETYPE] [-u] [-L] [-i ITER] [-x EXE] DIR
+
+    o͌` (͌ŒAx`̏Œ)F
+      bench files bytes sec files_per_sec mb_per_sec
+    bytesparse/get_id3_repair_sizeł̓^ÖAȊO̓t@CS
+
+  쐬ҁ@@Fgbm
+*/
+
+
+/****************************************************/
+/*                     include                      */
+/****************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "../id3tag.h"
+#include "../crc32.h"
+
+
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+#define BENCH_ITER 20
+#define BENCH_FILE_EXT ".mp3"
+#define BENCH_TMP_TEMPLATE "/tmp/id3bench.XXXXXX"
+
+
+
+/****************************************************/
+/*                      struct                      */
+/****************************************************/
+
+/* BENCHfile ****************************
+   vΏۃt@C1
+****************************************/
+typedef struct benchfile{
+	char path[FILENAME_MAX];
+	unsigned char *tag;        // ^Ö̃Rs[
+	size_t tagsize;
+	off_t filesize;
+	int repair;                // CKv
+}BENCHFILE;
+
+
+/* BENCHresult **************************/
+typedef struct benchresult{
+	unsigned long long files;
+	unsigned long long bytes;
+	double sec;
+}BENCHRESULT;
+
+
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+static double now_sec(void);
+static int cmp_bench_file(const void *a, const void *b);
+static int load_bench_files(const char *dir, BENCHFILE **list, int *num);
+static int load_bench_tag(BENCHFILE *f);
+static int bench_parse(BENCHFILE *list, int num, const ID3OPTION *option, int iter, BENCHRESULT *parse, BENCHRESULT *size);
+static int bench_repair(BENCHFILE *list, int num, const ID3OPTION *option, int iter, BENCHRESULT *res);
+static int bench_cli(BENCHFILE *list, int num, const char *exe, char *const *args, BENCHRESULT *res);
+static int copy_file(const char *src, const char *dst);
+static void print_result(const char *name, const BENCHRESULT *res);
+
+
+
+/****************************************************/
+/*                    Process                       */
+/****************************************************/
+
+/* main *********************************/
+int main(int argc, char *argv[]) {
+	ID3OPTION option;
+	BENCHFILE *list = NULL;
+	BENCHRESULT parse, size, repair, cli;
+	const char *exe = NULL;
+	char *args[12];
+	int iter = BENCH_ITER;
+	int num = 0, nargs = 0;
+	int c, i;
+
+	memset(&option, 0, sizeof(option));
+	while ((c = getopt(argc, argv, "rd:uLi:x:")) != -1) {
+		switch (c) {
+		case 'r':
+			option.flag |= OPTFLAG_REPETITION;
+			args[nargs++] = "-r";
+			break;
+		case 'd':
+			if (add_id3_rule(&option, optarg, RULE_DELETE)) {
+				fprintf(stderr, "frame type error : %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			args[nargs++] = "-d";
+			args[nargs++] = optarg;
+			break;
+		case 'u':
+			option.flag |= OPTFLAG_DEDUP;
+			args[nargs++] = "--dedup";
+			break;
+		case 'L':
+			option.keep = KEEP_LARGEST;
+			args[nargs++] = "--keep";
+			args[nargs++] = "largest";
+			break;
+		case 'i':
+			iter = atoi(optarg);
+			if (iter <= 0) iter = 1;
+			break;
+		case 'x':
+			exe = optarg;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-r] [-d FRAMETYPE] [-u] [-L] [-i ITER] [-x EXE] DIR\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	args[nargs] = NULL;
+	if (optind + 1 != argc) {
+		fprintf(stderr, "Usage: %s [-r] [-d FRAMETYPE] [-u] [-L] [-i ITER] [-x EXE] DIR\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (load_bench_files(argv[optind], &list, &num)) {
+		fprintf(stderr, "corpus read error : %s\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	if (bench_parse(list, num, &option, iter, &parse, &size)) return EXIT_FAILURE;
+	if (bench_repair(list, num, &option, iter, &repair)) return EXIT_FAILURE;
+
+	printf("# id3bench files=%d iter=%d scan=%s crc=%s\n", num, iter, get_scan_kernel(), get_crc32_kernel());
+	printf("bench\tfiles\tbytes\tsec\tfiles_per_sec\tmb_per_sec\n");
+	print_result("parse_id3_tag", &parse);
+	print_result("get_id3_repair_size", &size);
+	print_result("repair_id3_tag", &repair);
+	if (exe != NULL) {
+		if (bench_cli(list, num, exe, args, &cli)) return EXIT_FAILURE;
+		print_result("cli", &cli);
+	}
+
+	for (i = 0; i < num; i++) free(list[i].tag);
+	free(list);
+	return EXIT_SUCCESS;
+}
+
+
+/* now_sec ******************************/
+static double now_sec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* cmp_bench_file ***********************/
+static int cmp_bench_file(const void *a, const void *b) {
+	return strcmp(((const BENCHFILE *)a)->path, ((const BENCHFILE *)b)->path);
+}
+
+
+/* load_bench_files *********************
+   dir*.mp3𖼑OɕׁA^Öǂݍ
+   ߂lF0 G[-1
+****************************************/
+static int load_bench_files(const char *dir, BENCHFILE **list, int *num) {
+	DIR *dp;
+	struct dirent *ent;
+	BENCHFILE *p;
+	size_t len, extlen = strlen(BENCH_FILE_EXT);
+	int max = 0;
+
+	dp = opendir(dir);
+	if (dp == NULL) return RET_ERROR;
+	while ((ent = readdir(dp)) != NULL) {
+		len = strlen(ent->d_name);
+		if ((len <= extlen) || strcmp(ent->d_name + len - extlen, BENCH_FILE_EXT)) continue;
+		if (*num >= max) {
+			max = max ? max * 2 : 256;
+			p = realloc(*list, sizeof(BENCHFILE) * max);
+			if (p == NULL) goto LOAD_BENCH_FILES_ERROR;
+			*list = p;
+		}
+		p = &((*list)[*num]);
+		memset(p, 0, sizeof(*p));
+		if (FILENAME_MAX <= snprintf(p->path, FILENAME_MAX, "%s/%s", dir, ent->d_name)) continue;
+		(*num)++;
+	}
+	closedir(dp);
+
+	qsort(*list, *num, sizeof(BENCHFILE), cmp_bench_file);
+	for (max = 0; max < *num; max++) {
+		if (load_bench_tag(&((*list)[max]))) {
+			fprintf(stderr, "tag read error : %s\n", (*list)[max].path);
+			return RET_ERROR;
+		}
+	}
+	return RET_OK;
+
+  LOAD_BENCH_FILES_ERROR:
+	closedir(dp);
+	return RET_ERROR;
+}
+
+
+/* load_bench_tag ***********************
+   ^Öɕ
+   ߂lF0 G[-1
+****************************************/
+static int load_bench_tag(BENCHFILE *f) {
+	ID3TAG tag;
+	struct stat st;
+	int fd;
+
+	fd = open(f->path, O_RDONLY);
+	if (fd < 0) return RET_ERROR;
+	if (fstat(fd, &st) || read_id3_tag(&tag, fd, READER_MMAP)) {
+		close(fd);
+		return RET_ERROR;
+	}
+	f->filesize = st.st_size;
+	f->tagsize = tag.tagsize;
+	f->tag = malloc(f->tagsize);
+	if (f->tag != NULL) memcpy(f->tag, tag.reader.base, f->tagsize);
+	free_id3_tag(&tag);
+	close(fd);
+
+	return (f->tag != NULL) ? RET_OK : RET_ERROR;
+}
+
+
+/* bench_parse **************************
+   ̃^Oɑ΂parse_id3_tagget_id3_repair_size
+   iter񂸂s (free͌vȂ)
+   ߂lF0 G[-1
+****************************************/
+static int bench_parse(BENCHFILE *list, int num, const ID3OPTION *option, int iter, BENCHRESULT *parse, BENCHRESULT *size) {
+	ID3TAG tag;
+	unsigned char *buf;
+	unsigned int ret;
+	double t0, t1, t2;
+	int i, n;
+
+	memset(parse, 0, sizeof(*parse));
+	memset(size, 0, sizeof(*size));
+	for (n = 0; n < iter; n++) {
+		for (i = 0; i < num; i++) {
+			buf = malloc(list[i].tagsize);
+			if (buf == NULL) return RET_ERROR;
+			memcpy(buf, list[i].tag, list[i].tagsize);
+			memset(&tag, 0, sizeof(tag));
+			open_id3_reader_buf(&(tag.reader), buf, list[i].tagsize);
+
+			t0 = now_sec();
+			if (parse_id3_tag(&tag)) return RET_ERROR;
+			t1 = now_sec();
+			ret = get_id3_repair_size(&tag, option);
+			t2 = now_sec();
+			if (RET_ERROR == ret) return RET_ERROR;
+			list[i].repair = (ret != 0);
+			free_id3_tag(&tag);
+
+			parse->sec += t1 - t0;
+			size->sec += t2 - t1;
+			parse->bytes += list[i].tagsize;
+		}
+	}
+	parse->files = (unsigned long long)num * iter;
+	size->files = parse->files;
+	size->bytes = parse->bytes;
+
+	return RET_OK;
+}
+
+
+/* bench_repair *************************
+   CKvȃt@Cɑ΂repair_id3_tag
+   iter񂸂s (o͈͐ꎞt@C)
+   ߂lF0 G[-1
+****************************************/
+static int bench_repair(BENCHFILE *list, int num, const ID3OPTION *option, int iter, BENCHRESULT *res) {
+	ID3TAG tag;
+	ID3JOB job;
+	FILE *fpr, *fpw;
+	unsigned int headersize;
+	double t0;
+	int i, n, fd;
+
+	memset(res, 0, sizeof(*res));
+	memset(&job, 0, sizeof(job));
+	job.option = option;
+	job.log = stderr;
+
+	fpw = tmpfile();
+	if (fpw == NULL) return RET_ERROR;
+
+	for (n = 0; n < iter; n++) {
+		for (i = 0; i < num; i++) {
+			if (! list[i].repair) continue;
+
+			fpr = fopen(list[i].path, "rb");
+			if (fpr == NULL) goto BENCH_REPAIR_ERROR;
+			fd = fileno(fpr);
+			if (read_id3_tag(&tag, fd, READER_MMAP)) goto BENCH_REPAIR_ERROR;
+			headersize = get_id3_repair_size(&tag, option);
+			if ((0 == headersize) || (RET_ERROR == headersize)) goto BENCH_REPAIR_ERROR;
+			if (fseeko(fpw, 0, SEEK_SET) || ftruncate(fileno(fpw), 0)) goto BENCH_REPAIR_ERROR;
+
+			t0 = now_sec();
+			if (repair_id3_tag(fpw, fpr, &tag, headersize, &job)) goto BENCH_REPAIR_ERROR;
+			if (fflush(fpw)) goto BENCH_REPAIR_ERROR;
+			res->sec += now_sec() - t0;
+
+			free_id3_tag(&tag);
+			fclose(fpr);
+			res->files++;
+			res->bytes += list[i].filesize;
+		}
+	}
+	fclose(fpw);
+	return RET_OK;
+
+  BENCH_REPAIR_ERROR:
+	fprintf(stderr, "repair error : %s\n", list[i].path);
+	fclose(fpw);
+	return RET_ERROR;
+}
+
+
+/* bench_cli ****************************
+   DIRꎞfBNgɃRs[Aexe1s
+   (Rs[͌vȂ)
+   ߂lF0 G[-1
+****************************************/
+static int bench_cli(BENCHFILE *list, int num, const char *exe, char *const *args, BENCHRESULT *res) {
+	char tmpdir[] = BENCH_TMP_TEMPLATE;
+	char path[FILENAME_MAX];
+	char *argv[16];
+	const char *name;
+	pid_t pid;
+	double t0;
+	int i, n, status, devnull;
+
+	memset(res, 0, sizeof(*res));
+	if (mkdtemp(tmpdir) == NULL) return RET_ERROR;
+
+	for (i = 0; i < num; i++) {
+		name = strrchr(list[i].path, '/');
+		name = (name != NULL) ? name + 1 : list[i].path;
+		if (FILENAME_MAX <= snprintf(path, FILENAME_MAX, "%s/%s", tmpdir, name)) return RET_ERROR;
+		if (copy_file(list[i].path, path)) return RET_ERROR;
+		res->bytes += list[i].filesize;
+	}
+	res->files = num;
+
+	n = 0;
+	argv[n++] = (char *)exe;
+	for (i = 0; args[i] != NULL; i++) argv[n++] = args[i];
+	argv[n++] = tmpdir;
+	argv[n] = NULL;
+
+	t0 = now_sec();
+	pid = fork();
+	if (pid < 0) return RET_ERROR;
+	if (pid == 0) {
+		devnull = open("/dev/null", O_WRONLY);
+		if (devnull >= 0) dup2(devnull, STDOUT_FILENO);
+		execv(exe, argv);
+		_exit(127);
+	}
+	if (waitpid(pid, &status, 0) < 0) return RET_ERROR;
+	res->sec = now_sec() - t0;
+
+	// n (.bak܂߂ď)
+	snprintf(path, FILENAME_MAX, "rm -rf '%s'", tmpdir);
+	if (system(path)) fprintf(stderr, "cleanup failed : %s\n", tmpdir);
+
+	if (! WIFEXITED(status) || (WEXITSTATUS(status) != EXIT_SUCCESS)) {
+		fprintf(stderr, "%s exited abnormally (%d)\n", exe, status);
+		return RET_ERROR;
+	}
+	return RET_OK;
+}
+
+
+/* copy_file ****************************
+   ߂lF0 G[-1
+****************************************/
+static int copy_file(const char *src, const char *dst) {
+	FILE *fpr, *fpw;
+	int ret;
+
+	fpr = fopen(src, "rb");
+	if (fpr == NULL) return RET_ERROR;
+	fpw = fopen(dst, "wb");
+	if (fpw == NULL) {
+		fclose(fpr);
+		return RET_ERROR;
+	}
+	ret = fcopy(fpw, fpr, NULL);
+	fclose(fpr);
+	if (fclose(fpw)) ret = RET_ERROR;
+
+	return ret;
+}
+
+
+/* print_result *************************/
+static void print_result(const char *name, const BENCHRESULT *res) {
+	double sec = (res->sec > 0) ? res->sec : 1e-9;
+
+	printf("%s\t%llu\t%llu\t%.6f\t%.1f\t%.2f\n", name, res->files, res->bytes, res->sec,
+		   res->files / sec, res->bytes / sec / (1024.0 * 1024.0));
+}
@@ -0,0 +1,318 @@
+/*
+  F
+    opt [--cache FILE] ̑ʃLbV
+    Et@C͌Œ蒷record̕тŁAupdate_id3_cache̓x1
+      O_APPEND1writeŒǋL (rŗĂŐL^͎c)
+    Eǂݍݎmagicsum̍Ȃrecord͎̂āȀ͐؂l߂
+    Eclose_id3_cacheŒǋLΓinoděÂL^
+      ꎞt@CɏArenameŒu
+
+  쐬ҁ@@Fgbm
+*/
+
+
+/****************************************************/
+/*                     include                      */
+/****************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h> // offsetof
+#include <fcntl.h>
+#include <unistd.h>
+#include "cache.h"
+
+
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+#define CACHE_MAGIC 0x43334449      // "ID3C"
+#define CACHE_VERSION 2             // record̈Ӗςグ
+#define CACHE_TABLE_MIN 1024
+#define CACHE_READ_NUM 1024         // 1readœǂrecord
+#define CACHE_TMP_SUFFIX ".tmp"
+
+#define CACHE_MTIME(st) ((unsigned long long)(st)->st_mtim.tv_sec * 1000000000ULL + (st)->st_mtim.tv_nsec)
+#define CACHE_SUM(rec) hash_id3_data((rec), offsetof(ID3CACHEREC, sum), CACHE_MAGIC)
+
+
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+static ID3CACHEREC *find_id3_cache(ID3CACHE *cache, unsigned long long dev, unsigned long long ino);
+static int grow_id3_cache(ID3CACHE *cache, size_t tablesize);
+static int insert_id3_cache(ID3CACHE *cache, const ID3CACHEREC *rec);
+static int load_id3_cache(ID3CACHE *cache);
+static int compact_id3_cache(ID3CACHE *cache);
+
+
+
+/****************************************************/
+/*                    Process                       */
+/****************************************************/
+
+/* get_id3_cache_key ********************
+   get_id3_repair_sizěʂɉeoptionhash
+   optionႤs̋L^͎gȂ
+****************************************/
+unsigned long long get_id3_cache_key(const ID3OPTION *option) {
+	struct {
+		unsigned int version;
+		unsigned int flag;
+		unsigned char keep;
+		unsigned int padding;
+		unsigned int maxpadding;
+		unsigned int maxapic;
+	} key;
+	ID3RULE rule[RULE_MAX];
+	int i;
+
+	memset(&key, 0, sizeof(key));
+	key.version = CACHE_VERSION;
+	key.flag = option->flag & (OPTFLAG_REPETITION | OPTFLAG_DELETE | OPTFLAG_DEDUP | OPTFLAG_INPLACE
+							   | OPTFLAG_PADDING | OPTFLAG_MAXPADDING | OPTFLAG_NOUNSYNC | OPTFLAG_MAXAPIC);
+	key.keep = option->keep;
+	if (option->flag & OPTFLAG_PADDING) key.padding = option->padding;
+	if (option->flag & OPTFLAG_MAXPADDING) key.maxpadding = option->maxpadding;
+	if (option->flag & OPTFLAG_MAXAPIC) key.maxapic = option->maxapic;
+
+	// rule͏ɕł̂ŁAw͓keyɂȂ
+	memset(rule, 0, sizeof(rule));
+	for (i = 0; i < option->rulenum; i++) {
+		rule[i].fourcc = option->rule[i].fourcc;
+		rule[i].action = option->rule[i].action;
+	}
+
+	return hash_id3_data(rule, sizeof(ID3RULE) * option->rulenum, hash_id3_data(&key, sizeof(key), 0));
+}
+
+
+/* open_id3_cache ***********************
+   path̃LbVǂݍ݁AǋLł悤ɊJ
+   ΍쐬
+   ߂lF(F0@sF-1)
+****************************************/
+int open_id3_cache(ID3CACHE *cache, const char *path, unsigned long long optkey) {
+	memset(cache, 0, sizeof(*cache));
+	cache->fd = -1;
+	cache->optkey = optkey;
+	if (strlen(path) + strlen(CACHE_TMP_SUFFIX) >= FILENAME_MAX) return RET_ERROR;
+	strncpy(cache->path, path, FILENAME_MAX - 1);
+
+	if (grow_id3_cache(cache, CACHE_TABLE_MIN)) return RET_ERROR;
+	pthread_mutex_init(&(cache->lock), NULL);
+
+	cache->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0666);
+	if (cache->fd < 0) goto OPEN_ID3_CACHE_ERROR;
+	if (load_id3_cache(cache)) goto OPEN_ID3_CACHE_ERROR;
+
+	return RET_OK;
+
+  OPEN_ID3_CACHE_ERROR:
+	if (cache->fd >= 0) close(cache->fd);
+	cache->fd = -1;
+	free(cache->table);
+	cache->table = NULL;
+	pthread_mutex_destroy(&(cache->lock));
+	return RET_ERROR;
+}
+
+
+/* lookup_id3_cache *********************
+   st̃t@C̋L^T
+   size/mtimeAtaghash(0ȊO)łΈvƂ
+   ߂lFCACHE_HIT (recɋL^Rs[) / CACHE_MISS
+****************************************/
+int lookup_id3_cache(ID3CACHE *cache, const struct stat *st, unsigned long long taghash, ID3CACHEREC *rec) {
+	ID3CACHEREC *p;
+	int ret = CACHE_MISS;
+
+	pthread_mutex_lock(&(cache->lock));
+	p = find_id3_cache(cache, st->st_dev, st->st_ino);
+	if ((p->magic != 0) && (p->optkey == cache->optkey)) {
+		if ((p->size == (unsigned long long)st->st_size) && (p->mtime == CACHE_MTIME(st))) ret = CACHE_HIT;
+		else if ((taghash != 0) && (p->taghash == taghash)) ret = CACHE_HIT;
+		if (ret == CACHE_HIT) *rec = *p;
+	}
+	pthread_mutex_unlock(&(cache->lock));
+
+	return ret;
+}
+
+
+/* update_id3_cache *********************
+   st̃t@ČʂL^ALbVt@CɒǋL
+   report: NULLł0Ƃ
+   ߂lF(F0@sF-1)
+****************************************/
+int update_id3_cache(ID3CACHE *cache, const struct stat *st, unsigned long long taghash, unsigned int headersize, const ID3REPORT *report) {
+	ID3CACHEREC rec;
+	int ret = RET_OK;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.magic = CACHE_MAGIC;
+	rec.headersize = headersize;
+	rec.dev = st->st_dev;
+	rec.ino = st->st_ino;
+	rec.size = st->st_size;
+	rec.mtime = CACHE_MTIME(st);
+	rec.taghash = taghash;
+	rec.optkey = cache->optkey;
+	if (report != NULL) rec.report = *report;
+	rec.sum = CACHE_SUM(&rec);
+
+	pthread_mutex_lock(&(cache->lock));
+	if (insert_id3_cache(cache, &rec)) ret = RET_ERROR;
+	else if (sizeof(rec) != write(cache->fd, &rec, sizeof(rec))) ret = RET_ERROR;
+	else cache->append++;
+	pthread_mutex_unlock(&(cache->lock));
+
+	return ret;
+}
+
+
+/* close_id3_cache **********************
+   ǋL΃LbVt@Cĕ
+   ߂lF(F0@sF-1)
+****************************************/
+int close_id3_cache(ID3CACHE *cache) {
+	int ret = RET_OK;
+
+	if (cache->table == NULL) return RET_OK;
+	if (cache->append > 0) ret = compact_id3_cache(cache);
+	if (close(cache->fd)) ret = RET_ERROR;
+	free(cache->table);
+	cache->table = NULL;
+	pthread_mutex_destroy(&(cache->lock));
+
+	return ret;
+}
+
+
+/* find_id3_cache ***********************
+   dev/inőL^Aׂ󂫂Ԃ
+   (e[uɂ͕K󂫂)
+****************************************/
+static ID3CACHEREC *find_id3_cache(ID3CACHE *cache, unsigned long long dev, unsigned long long ino) {
+	size_t mask = cache->tablesize - 1;
+	size_t i = (((dev * HASH_PRIME1) ^ (ino * HASH_PRIME2)) >> 20) & mask;
+
+	while ((cache->table[i].magic != 0)
+		   && ((cache->table[i].dev != dev) || (cache->table[i].ino != ino))) {
+		i = (i + 1) & mask;
+	}
+	return &(cache->table[i]);
+}
+
+
+/* grow_id3_cache ***********************
+   e[utablesizeɍLē꒼
+   ߂lF(F0@sF-1)
+****************************************/
+static int grow_id3_cache(ID3CACHE *cache, size_t tablesize) {
+	ID3CACHEREC *old = cache->table;
+	size_t oldsize = cache->tablesize;
+	size_t i;
+
+	cache->table = calloc(tablesize, sizeof(ID3CACHEREC));
+	if (cache->table == NULL) {
+		cache->table = old;
+		return RET_ERROR;
+	}
+	cache->tablesize = tablesize;
+	for (i = 0; i < oldsize; i++) {
+		if (old[i].magic != 0) *find_id3_cache(cache, old[i].dev, old[i].ino) = old[i];
+	}
+	free(old);
+
+	return RET_OK;
+}
+
+
+/* insert_id3_cache *********************
+   rec (dev/inőL^͒u)
+   ܂e[u{ɂ
+   ߂lF(F0@sF-1)
+****************************************/
+static int insert_id3_cache(ID3CACHE *cache, const ID3CACHEREC *rec) {
+	ID3CACHEREC *p;
+
+	if ((cache->num + 1) * 2 > cache->tablesize) {
+		if (grow_id3_cache(cache, cache->tablesize * 2)) return RET_ERROR;
+	}
+	p = find_id3_cache(cache, rec->dev, rec->ino);
+	if (p->magic == 0) cache->num++;
+	*p = *rec;
+
+	return RET_OK;
+}
+
+
+/* load_id3_cache ***********************
+   LbVt@CSēǂݍ
+   ̋L^قǐV̂ŁAinode͏㏑
+   ߂lF(F0@sF-1)
+****************************************/
+static int load_id3_cache(ID3CACHE *cache) {
+	ID3CACHEREC rec[CACHE_READ_NUM];
+	off_t good = 0;
+	ssize_t len;
+	size_t i, n;
+
+	while ((len = read(cache->fd, rec, sizeof(rec))) > 0) {
+		n = len / sizeof(ID3CACHEREC);
+		for (i = 0; i < n; i++) {
+			if ((rec[i].magic != CACHE_MAGIC) || (rec[i].sum != CACHE_SUM(&(rec[i])))) {
+				cache->append++; // Ď̂Ă
+				continue;
+			}
+			if (insert_id3_cache(cache, &(rec[i]))) return RET_ERROR;
+		}
+		good += n * sizeof(ID3CACHEREC);
+		if (len % sizeof(ID3CACHEREC)) break;
+	}
+	if (len < 0) return RET_ERROR;
+
+	// record؂l߁AǋLʒu𑵂
+	if ((len > 0) && ftruncate(cache->fd, good)) return RET_ERROR;
+
+	return RET_OK;
+}
+
+
+/* compact_id3_cache ********************
+   e[u̓eꎞt@CɏALbVt@Cƒu
+   ߂lF(F0@sF-1)
+****************************************/
+static int compact_id3_cache(ID3CACHE *cache) {
+	char tmp[FILENAME_MAX];
+	FILE *fp;
+	size_t i;
+
+	if (FILENAME_MAX <= snprintf(tmp, FILENAME_MAX, "%s%s", cache->path, CACHE_TMP_SUFFIX)) return RET_ERROR;
+	fp = fopen(tmp, "wb");
+	if (fp == NULL) return RET_ERROR;
+
+	for (i = 0; i < cache->tablesize; i++) {
+		if (cache->table[i].magic == 0) continue;
+		if (1 != fwrite(&(cache->table[i]), sizeof(ID3CACHEREC), 1, fp)) goto COMPACT_ID3_CACHE_ERROR;
+	}
+	if (fflush(fp) || fsync(fileno(fp))) goto COMPACT_ID3_CACHE_ERROR;
+	if (fclose(fp)) {
+		unlink(tmp);
+		return RET_ERROR;
+	}
+	if (rename(tmp, cache->path)) {
+		unlink(tmp);
+		return RET_ERROR;
+	}
+
+	return RET_OK;
+
+  COMPACT_ID3_CACHE_ERROR:
+	fclose(fp);
+	unlink(tmp);
+	return RET_ERROR;
+}
@@ -0,0 +1,74 @@
+/*
+  F
+    opt [--cache FILE] ̑ʃLbV
+    Et@Cdevice/inode/size/mtimeŎʂA^Öhash
+      get_id3_repair_sizě(CsvACe)L^
+    EOƓł΃t@CJɌʂg
+    EL^1ǋLAIɏdď
+
+  쐬ҁ@@Fgbm
+*/
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "id3tag.h"
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+#define CACHE_MISS 0
+#define CACHE_HIT 1
+
+
+
+/****************************************************/
+/*                      struct                      */
+/****************************************************/
+
+/* ID3cacherec ***************************
+   LbVt@C1 (Œ蒷)
+   magic0̓̕e[ű
+******************************************/
+typedef struct id3cacherec{
+	unsigned int magic;
+	unsigned int headersize;   // get_id3_repair_sizě (0:Csv)
+	unsigned long long dev;
+	unsigned long long ino;
+	unsigned long long size;
+	unsigned long long mtime;  // ns
+	unsigned long long taghash;  // ^Öhash (0:s)
+	unsigned long long optkey;   // ʂɉeoption
+	ID3REPORT report;
+	unsigned long long sum;    // ܂łhash (̌o)
+}ID3CACHEREC;
+
+
+/* ID3cache ******************************
+   dev/inodeňnbVe[uƒǋL
+   (ob`[hworker瓯Ɏg)
+******************************************/
+typedef struct id3cache{
+	char path[FILENAME_MAX];
+	int fd;                    // ǋLp
+	ID3CACHEREC *table;
+	size_t tablesize;          // 2ׂ̂
+	size_t num;
+	size_t append;             // ǋL
+	unsigned long long optkey;
+	pthread_mutex_t lock;
+}ID3CACHE;
+
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+unsigned long long get_id3_cache_key(const ID3OPTION *option);
+int open_id3_cache(ID3CACHE *cache, const char *path, unsigned long long optkey);
+int lookup_id3_cache(ID3CACHE *cache, const struct stat *st, unsigned long long taghash, ID3CACHEREC *rec);
+int update_id3_cache(ID3CACHE *cache, const struct stat *st, unsigned long long taghash, unsigned int headersize, const ID3REPORT *report);
+int close_id3_cache(ID3CACHE *cache);
+
+#endif
@@ -0,0 +1,312 @@
+/*
+  F
+    gwb_CRC32 ( 0x04C11DB7 ̃rbg]Azlibcrc32Ɠl)
+    Ex86PCLMULQDQg64byte4{foldingA
+      128bit -> 64bit -> BarrettҌ32bitɂ (16byte̎cslicing-by-8)
+    EARMv8CRC32߂g8byte__crc32dg
+    EȊOslicing-by-8 (\͏pthread_onceō)
+      (ϐ ID3REPAIR_CRC=pclmul|armv8|slice8 ŌŒł)
+    Iscan.cƓɌ߂atomicŋL
+
+  Ql :
+     Intel "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction"
+
+  쐬ҁ@@Fgbm
+*/
+
+
+/****************************************************/
+/*                     include                      */
+/****************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRC32_X86
+#endif
+#if defined(__aarch64__) && !defined(__ARM_BIG_ENDIAN)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#define CRC32_ARM
+#endif
+#include "crc32.h"
+
+
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+#define CRC32_POLY 0xEDB88320       // 0x04C11DB7 ̃rbg]
+#define CRC32_SLICE 8
+#define CRC32_FOLD_MIN 64           // PCLMULQDQŏŏbyte
+#define CRC32_FOLD_BLOCK 16
+
+#define CRC32_ENV "ID3REPAIR_CRC"
+
+
+
+/****************************************************/
+/*                      struct                      */
+/****************************************************/
+typedef unsigned int (*CRC32FUNC)(const unsigned char *buf, size_t size, unsigned int crc);
+
+/* ID3crckernel *************************
+   CRC32֐ƖO
+   crc͔]ς݂̓r̒l󂯓n
+****************************************/
+typedef struct id3crckernel{
+	const char *name;
+	CRC32FUNC func;
+}ID3CRCKERNEL;
+
+
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+static void init_crc32_table(void);
+static unsigned int crc32_slice8(const unsigned char *buf, size_t size, unsigned int crc);
+#ifdef CRC32_X86
+static unsigned int crc32_pclmul(const unsigned char *buf, size_t size, unsigned int crc);
+#endif
+#ifdef CRC32_ARM
+static unsigned int crc32_armv8(const unsigned char *buf, size_t size, unsigned int crc);
+#endif
+static const ID3CRCKERNEL *select_crc32_kernel(void);
+
+
+
+/****************************************************/
+/*                     global                       */
+/****************************************************/
+static const ID3CRCKERNEL g_crc32_kernel[] = {
+#ifdef CRC32_X86
+	{"pclmul", crc32_pclmul},
+#endif
+#ifdef CRC32_ARM
+	{"armv8", crc32_armv8},
+#endif
+	{"slice8", crc32_slice8},
+	{NULL, NULL}
+};
+
+static const ID3CRCKERNEL *g_crc32_select = NULL;   // atomicœǂݏ
+static unsigned int g_crc32_table[CRC32_SLICE][256];
+static pthread_once_t g_crc32_once = PTHREAD_ONCE_INIT;
+
+
+
+/****************************************************/
+/*                    Process                       */
+/****************************************************/
+
+/* crc32_id3_data ***********************
+   data[0]`data[size-1]CRC32
+   crc: 0AvZꍇ͑O̖߂l
+****************************************/
+unsigned int crc32_id3_data(const void *data, size_t size, unsigned int crc) {
+	if (data == NULL || size == 0) return crc;
+	return ~select_crc32_kernel()->func(data, size, ~crc);
+}
+
+
+/* get_crc32_kernel *********************
+   ߂lFgpCRC32֐̖O
+****************************************/
+const char *get_crc32_kernel(void) {
+	return select_crc32_kernel()->name;
+}
+
+
+/* select_crc32_kernel ******************
+   CPU𒲂ׂCRC32֐߂
+   (Xbh瓯ɌĂ΂ĂʂɂȂ)
+****************************************/
+static const ID3CRCKERNEL *select_crc32_kernel(void) {
+	const ID3CRCKERNEL *k;
+	const char *env;
+
+	k = __atomic_load_n(&g_crc32_select, __ATOMIC_ACQUIRE);
+	if (k != NULL) return k;
+
+	// ǂkernelcslicing-by-8ŏ̂Őɕ\
+	pthread_once(&g_crc32_once, init_crc32_table);
+
+	env = getenv(CRC32_ENV);
+	for (k = g_crc32_kernel; k->name != NULL; k++) {
+		if (env != NULL && *env != '\0') {
+			if (0 == strcmp(env, k->name)) break;
+			continue;
+		}
+#ifdef CRC32_X86
+		if (k->func == crc32_pclmul) {
+			__builtin_cpu_init();
+			if (! (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))) continue;
+		}
+#endif
+#ifdef CRC32_ARM
+		if ((k->func == crc32_armv8) && !(getauxval(AT_HWCAP) & HWCAP_CRC32)) continue;
+#endif
+		break;
+	}
+	if (k->name == NULL) k = &(g_crc32_kernel[sizeof(g_crc32_kernel) / sizeof(g_crc32_kernel[0]) - 2]); // slice8
+
+	__atomic_store_n(&g_crc32_select, k, __ATOMIC_RELEASE);
+	return k;
+}
+
+
+/* init_crc32_table *********************
+   slicing-by-8̕\
+   table[0]1byteAtable[i]͂̌0i byte
+****************************************/
+static void init_crc32_table(void) {
+	unsigned int c;
+	int i, j;
+
+	for (i = 0; i < 256; i++) {
+		c = i;
+		for (j = 0; j < 8; j++) c = (c & 1) ? (c >> 1) ^ CRC32_POLY : c >> 1;
+		g_crc32_table[0][i] = c;
+	}
+	for (i = 0; i < 256; i++) {
+		c = g_crc32_table[0][i];
+		for (j = 1; j < CRC32_SLICE; j++) {
+			c = (c >> 8) ^ g_crc32_table[0][c & 0xFF];
+			g_crc32_table[j][i] = c;
+		}
+	}
+}
+
+
+/* crc32_slice8 *************************
+   8byte\8
+****************************************/
+static unsigned int crc32_slice8(const unsigned char *buf, size_t size, unsigned int crc) {
+	const unsigned int (*t)[256] = g_crc32_table;
+
+	while (size >= CRC32_SLICE) {
+		crc ^= buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((unsigned int)buf[3] << 24);
+		crc = t[7][crc & 0xFF] ^ t[6][(crc >> 8) & 0xFF] ^ t[5][(crc >> 16) & 0xFF] ^ t[4][crc >> 24]
+			^ t[3][buf[4]] ^ t[2][buf[5]] ^ t[1][buf[6]] ^ t[0][buf[7]];
+		buf += CRC32_SLICE;
+		size -= CRC32_SLICE;
+	}
+
+	// c
+	while (size--) crc = (crc >> 8) ^ t[0][(crc ^ *buf++) & 0xFF];
+
+	return crc;
+}
+
+
+#ifdef CRC32_X86
+/* crc32_pclmul *************************
+   64byte4{128bit𓯎foldAŌ1{ւ܂Ƃ߂
+   萔 x^(n) mod P(x) (rbg]A33bit)
+     k1,k2: 512bit  k3,k4: 128bit  k5: 64bit
+     poly: P(x)BarrettҌ̏ floor(x^64 / P(x))
+****************************************/
+__attribute__((target("pclmul,sse4.1")))
+static unsigned int crc32_pclmul(const unsigned char *buf, size_t size, unsigned int crc) {
+	static const uint64_t k1k2[2] __attribute__((aligned(16))) = {0x0154442BD4ULL, 0x01C6E41596ULL};
+	static const uint64_t k3k4[2] __attribute__((aligned(16))) = {0x01751997D0ULL, 0x00CCAA009EULL};
+	static const uint64_t k5k0[2] __attribute__((aligned(16))) = {0x0163CD6124ULL, 0};
+	static const uint64_t poly[2] __attribute__((aligned(16))) = {0x01DB710641ULL, 0x01F7011641ULL};
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+	size_t len;
+
+	if (size < CRC32_FOLD_MIN) return crc32_slice8(buf, size, crc);
+	len = size & ~(size_t)(CRC32_FOLD_BLOCK - 1);
+	size -= len;
+
+	x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(buf + 0x00)), _mm_cvtsi32_si128(crc));
+	x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+	x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+	x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+	buf += CRC32_FOLD_MIN;
+	len -= CRC32_FOLD_MIN;
+
+	// 4{
+	x0 = _mm_load_si128((const __m128i *)k1k2);
+	while (len >= CRC32_FOLD_MIN) {
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(buf + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(buf + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(buf + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(buf + 0x30)));
+		buf += CRC32_FOLD_MIN;
+		len -= CRC32_FOLD_MIN;
+	}
+
+	// 1{ɂ܂Ƃ߂
+	x0 = _mm_load_si128((const __m128i *)k3k4);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	// 16byte
+	while (len >= CRC32_FOLD_BLOCK) {
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *)buf)), x5);
+		buf += CRC32_FOLD_BLOCK;
+		len -= CRC32_FOLD_BLOCK;
+	}
+
+	// 128bit -> 64bit
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, x3), x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// BarrettҌ 64bit -> 32bit
+	x0 = _mm_load_si128((const __m128i *)poly);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, x3), x0, 0x10);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, x3), x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	crc = _mm_extract_epi32(x1, 1);
+
+	// c
+	return crc32_slice8(buf, size, crc);
+}
+#endif
+
+
+#ifdef CRC32_ARM
+/* crc32_armv8 **************************
+   8byteCRC32߂g
+****************************************/
+__attribute__((target("+crc")))
+static unsigned int crc32_armv8(const unsigned char *buf, size_t size, unsigned int crc) {
+	uint64_t w;
+
+	while (size >= 8) {
+		memcpy(&w, buf, 8);
+		crc = __crc32d(crc, w);
+		buf += 8;
+		size -= 8;
+	}
+	while (size--) crc = __crc32b(crc, *buf++);
+
+	return crc;
+}
+#endif
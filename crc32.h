@@ -0,0 +1,21 @@
+/*
+  F
+    gwb_CRC32 (ISO 3309Azlibcrc32Ɠl)
+    EPCLMULQDQ(x86)CRC32(ARMv8)g΂A
+      slicing-by-8g
+    EO̖߂lnΑvZł
+
+  쐬ҁ@@Fgbm
+*/
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+unsigned int crc32_id3_data(const void *data, size_t size, unsigned int crc);
+const char *get_crc32_kernel(void);
+
+#endif
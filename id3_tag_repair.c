@@ -3,8 +3,8 @@
     ID3^OAPICt[MIME^CvCc[
     optionœ^CvAPICt[2Ԗڈȍ~폜\
 	optionŎwt[̑S폜\
-	Egwb_CRC32ɂ͖Ή
-	Et[̈kÍɂ͖Ή
+	Egwb_CRC32͓ǂݍݎɊm߁AoɌvZ
+	Ekt[͕KvȎzlibœWJBÍt[͂̂܂܎c
   
   Ql :
      http://www.takaaki.info/id3/ID3v2.3.0J.html
@@ -18,75 +18,82 @@
 /****************************************************/
 /*                     include                      */
 /****************************************************/
+#define _GNU_SOURCE // open_memstream
 #include <stdio.h>
 #include <stdlib.h> // exit
 #include <string.h> // strlen
 #include <getopt.h> // getopt_long
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <strings.h> // strcasecmp
+#include <dirent.h> // opendir
+#include <pthread.h>
+#include <fcntl.h> // open
+#include <sys/ioctl.h>
+#include <linux/fs.h> // FICLONE
+#include <poll.h>
+#include <signal.h>
+#include <sys/signalfd.h>
+#include "id3tag.h"
+#include "pool.h"
+#include "uring.h"
+#include "cache.h"
+#include "watch.h"
+#include "journal.h"
 
 
 
 /****************************************************/
 /*                      define                      */
 /****************************************************/
-//#define DEBUG_ON
-//#define DEBUG2_ON
+#define LONGOPT_REPETITION 0    // long opt num
+#define LONGOPT_DELETE 1        // long opt num
+#define LONGOPT_VERBOSE 2       // long opt num
+#define LONGOPT_INPLACE 3       // long opt num
+#define LONGOPT_JOBS 4          // long opt num
+#define LONGOPT_FILES0FROM 5    // long opt num
+#define LONGOPT_URING 6         // long opt num
+#define LONGOPT_CHECK 7         // long opt num
+#define LONGOPT_STATS 8         // long opt num
+#define LONGOPT_CACHE 9         // long opt num
+#define LONGOPT_DEDUP 10        // long opt num
+#define LONGOPT_KEEP 11         // long opt num
+#define LONGOPT_RULES 12        // long opt num
+#define LONGOPT_PADDING 13      // long opt num
+#define LONGOPT_MAXPADDING 14   // long opt num
+#define LONGOPT_NOUNSYNC 15     // long opt num
+#define LONGOPT_MAXAPIC 16      // long opt num
+#define LONGOPT_WATCH 17        // long opt num
+#define LONGOPT_COLLAPSE 18     // long opt num
+#define LONGOPT_JOURNAL 19      // long opt num
 
-#define RET_OK 0
-#define RET_ERROR -1
-#define RET_FAILURE 1
-#define RET_REPETITION 1
+#define RULES_LINE_SIZE 1024    // --rules1s̍ő咷
+#define RULE_NAME_NUM 3
 
-#define FOUR_BYTE 0x04
+#define BATCH_QUEUE_PER_WORKER 1024      // worker̖t@C
+#define BATCH_LOG_FLUSH_SIZE (64 * 1024) // verboseo͂܂Ƃ߂ďoTCY
+#define BATCH_FILE_EXT ".mp3"            // fBNgTőΏۂɂgq
 
-#define STR_BUF 8
-#define READ_BUF_SIZE 256
-#define MIMETYPE_MAXSIZE 64
+#define WATCH_DELAY_MS 500               // --watch Ō̃Cxg珈܂
+#define WATCH_FILE_MAX 4096              // --watch ҂t@C̏
 
-#define ID3_HEADER_SIZE 10
-#define ID3_HEADER_ID_CHECK "ID3"
-#define ID3_HEADER_VERSION_CHECK 0x03
-#define ID3_HEADER_ID_SIZE 3
-#define ID3_FRAME_ID_PIC "APIC"
-#define ID3_FRAME_ID_SIZE 4
-#define ID3_FRAME_SIZE 10
+#define CHECK_CLEAN 0           // --check o͂̏
+#define CHECK_REPAIR 1
+#define CHECK_ERROR 2
 
-#define LONGOPT_REPETITION 0    // long opt num
-#define OPTFLAG_REPETITION 0x01 // optflag
+#define EXIT_REPAIR 2           // --check ŏCKvȃt@C
 
-#define LONGOPT_DELETE 1        // long opt num
-#define OPTFLAG_DELETE 0x02     // optflag
+#define STREAM_NAME "-"         // stdinǂstdout֏o
 
-#define LONGOPT_VERBOSE 2       // long opt num
-#define OPTFLAG_VERBOSE 0x04    // optflag
-
-#define APICTYPE_NUM 0x15
-
-#define REVERSE_ENDIAN(n)				\
-	(									\
-		  ((n & 0xFF000000) >> 24)		\
-		| ((n & 0x00FF0000) >> 8)		\
-		| ((n & 0x0000FF00) << 8)		\
-		| ((n & 0x000000FF) << 24)		\
-	)
-
-// SYNCHSAFEϊnv2.3^Oł͗pȂ(v2.4only)
-// v2.3łwb_TCŶݓ`ŕۑ
-// ENDIANϊ
-#define FROM_SYNCHSAFE(n)			\
-	(								\
-     	  ((n & 0x7F000000) >> 24)	\
-     	+ ((n & 0x007F0000) >> 9)	\
-     	+ ((n & 0x00007F00) << 6)	\
-		+ ((n & 0x0000007F) << 21)	\
-	)
-
-#define TO_SYNCHSAFE(n)				\
-	(								\
-     	  ((n & 0x0FE00000) >> 21)	\
-     	+ ((n & 0x001FC000) >> 6)	\
-     	+ ((n & 0x00003F80) << 9)	\
-		+ ((n & 0x0000007F) << 24)	\
-	)
+#define BACKUP_RENAME 0         // .bakւ̖OύXƑŜ̃Rs[
+#define BACKUP_REFLINK 1        // .bakreflinkō쐬t@C
+
+#define URING_SLOT_NUM 64                // ɏt@C
+#define URING_ENTRIES 128                // SQE̐
+#define URING_SUBMIT_BATCH 16            // ܂Ƃ߂submitSQE̐
+#define URING_COPY_SIZE (256 * 1024)     // f[^̈Rs[̒P
 
 
 
@@ -94,109 +101,121 @@
 /*                      struct                      */
 /****************************************************/
 
-/* ID3header *************************
-   
-     ID3v2/t@Cʎq      "ID3"
-     ID3v2 o[W          $03 00
-     ID3v2 tO              %abcd0000
-     ID3v2 TCY          4 * %0xxxxxxx
-
-  *ID3v2^OTCY͊gwb_APadding̈ASẴt[̃oCgi
-   [ĂBtb^݂ĂꍇA̒l('S' - 20)oCgA
-   łȂ('S' - 10)oCgɓB
-
-**************************************/
-typedef struct id3header{
-	char id3[ID3_HEADER_ID_SIZE];
-	unsigned char version[2];
-	unsigned char flag;
-	unsigned int size;
-}ID3HEADER;
-
-#define FLAG_SYN 0x80
-#define FLAG_EXT 0x40
-#define FLAG_EXP 0x20
-//#define FLAG_FTR 0x10 v2.4
-
-
-/* ID3extheader **************************
-   gwb_TCY $xx xx xx xx
-   gtO $xx xx
-   Padding̈̃TCY $xx xx xx xx
+/* ID3worker *****************************
+   ob`[hworkeȑo̓obt@
 ******************************************/
-typedef struct id3extheader{
-	unsigned int size;
-	unsigned char flag[2];
-	unsigned int padding_size;
-	unsigned char crc[4];
-} ID3EXTHEADER;
-
-#define EXT_FLAG_CRC 0x80
+typedef struct id3worker{
+	FILE *log;                 // open_memstream
+	char *logbuf;
+	size_t logsize;
+	ID3STATS stats;            // opt [--stats] ̏Wv
+}ID3WORKER;
 
 
-/* ID3frameheader **************************
-     t[ ID      $xx xx xx xx  (S)
-     TCY       4 * %0xxxxxxx
-     tO           $xx xx
+/* ID3slot *******************************
+   io_uringGWŏ̃t@C1
+******************************************/
+typedef struct id3slot{
+	int state;
+	ID3JOB job;
+	ID3TAG tag;
+	unsigned int headersize;
+	int fdr;
+	int fdw;
+	unsigned char *buf;        // ǂݍݒ̃^O / C̃^O / Rs[p
+	size_t buflen;
+	size_t bufsize;
+	size_t done;               // ݍςbyte
+	off_t in;                  // f[^̈̃Rs[ʒu
+	off_t out;
+	off_t end;
+	char bak[FILENAME_MAX];
+	ID3STATS stats;            // opt [--stats] (I/OCQĚʂ琔)
+	unsigned long long taghash;  // opt [--cache]
+}ID3SLOT;
+
+#define SLOT_FREE 0
+#define SLOT_READ_TAG 1
+#define SLOT_RENAME 2
+#define SLOT_WRITE_TAG 3
+#define SLOT_READ_DATA 4
+#define SLOT_WRITE_DATA 5
+#define SLOT_FSYNC 6
+#define SLOT_FSYNC_DIR 7
+
+
+/* ID3uringbatch *************************
+   io_uringGW̏
+   t@C̓ǂݍ݁E݂𓯎ɔsA
+   Ɏ̏֐i߂
 ******************************************/
-typedef struct id3frameheader{
-	char id[ID3_FRAME_ID_SIZE];
-	unsigned int size;
-	unsigned char flag[2];
-}ID3FRAMEHEADER;
-
-
-/* ID3APICframe **************************
-   Text encoding $xx
-   MIME type <text string> $00
-   Picture type $xx
-   Description <text string according to encoding> $00 (00)
-   Picture data <binary data>
+typedef struct id3uringbatch{
+	ID3URING ring;
+	ID3SLOT slot[URING_SLOT_NUM];
+	const ID3OPTION *option;
+	int active;                // ̃Xbg
+	int renameat;              // IORING_OP_RENAMEATg
+	int *failed;               // ID3BATCH̏Wv
+	int *repair;
+	ID3STATS *total;
+	ID3CACHE *cache;
+	ID3JOURNAL *journal;
+}ID3URINGBATCH;
+
+
+/* ID3batch ******************************
+   ob`[h̏
 ******************************************/
-typedef struct id3apicframe{
-	unsigned char encode;
-	char mimetype[MIMETYPE_MAXSIZE];
-	unsigned char pictype;
-	unsigned char description;
-	unsigned char *data;
-	
-}ID3APICFRAME;
-
-#define PICTURE_TYPE_NUM 0x15
+typedef struct id3batch{
+	const ID3OPTION *option;
+	ID3POOL *pool;
+	ID3URINGBATCH *uring;      // io_uringGWgp
+	ID3WORKER *worker;
+	int num;
+	int failed;                // st@C (atomic)
+	int repair;                // --checkŏCKvȃt@C (atomic)
+	pthread_mutex_t outlock;   // Wo͂ւ̏o
+	ID3STATS stats;            // opt [--stats] ̏Wv
+	ID3CACHE *cache;           // opt [--cache] łȂNULL
+	int flushlog;              // 1verboseo͂o (--watch)
+	ID3JOURNAL *journal;       // opt [--journal] łȂNULL
+}ID3BATCH;
 
 
 
 /****************************************************/
 /*                   prototype                      */
 /****************************************************/
-int fpstr(FILE *fp, const char *str, fpos_t npos);
-int fcopy(FILE *fpw, FILE *fpr);
-int fncopy(FILE *fpw, FILE *fpr, size_t n);
-
-int read_id3_header(ID3HEADER *header, FILE *fp);
-int read_id3_extheader(ID3EXTHEADER *header, FILE *fp);
-int read_id3_frame_header(ID3FRAMEHEADER *header, FILE *fp);
-
-int write_id3_header(const ID3HEADER *header, FILE *fp);
-int write_id3_extheader(const ID3EXTHEADER *header, FILE *fp);
-int write_id3_frame(const ID3FRAMEHEADER *header, FILE *fpr, FILE *fpw);
-int write_id3_repair_apic_frame(const ID3FRAMEHEADER *header, FILE *fpr, FILE *fpw);
-
-int seek_id3_next_frame(FILE *fp, const ID3FRAMEHEADER *header);
-int get_id3_apic_type(FILE *fp, unsigned char *apictype);
-
-int check_id3_mime_type(FILE *fp);
-unsigned int get_id3_repair_size(FILE *fp);
-int repair_id3_tag(FILE *fpw, FILE *fpr, unsigned int headersize);
-
-
-
-/****************************************************/
-/*                     Global                       */
-/****************************************************/
-static unsigned char g_flag = 0;
-static char g_del_frametype[ID3_FRAME_ID_SIZE+1];
-static char g_filename[FILENAME_MAX];
+int parse_id3_rules(ID3OPTION *option, const char *list, int action);
+int load_id3_rules(ID3OPTION *option, const char *path);
+int parse_id3_padding(const char *str, unsigned int *size);
+int repair_id3_file(ID3JOB *job);
+int process_id3_file(ID3JOB *job);
+int process_id3_stream(ID3JOB *job);
+void print_id3_check(const ID3JOB *job, int status, const ID3REPORT *report);
+int skip_id3_cache(ID3JOB *job, unsigned long long taghash, int *ret);
+void save_id3_cache(ID3JOB *job, unsigned long long taghash, unsigned int headersize, const ID3REPORT *report);
+int clone_id3_backup(int fd, const char *bak);
+int journal_id3_file(ID3JOB *job, int fd, int method, const ID3TAG *tag);
+int sync_id3_file(ID3JOB *job, FILE *fp, int dir);
+void print_id3_backup(const ID3JOB *job, const char *bak, int strategy);
+void batch_worker(void *item, int worker, void *arg);
+void flush_batch_log(ID3BATCH *batch, ID3WORKER *w);
+int open_batch(ID3BATCH *batch, const ID3OPTION *option, int jobs, int uring, ID3CACHE *cache, ID3JOURNAL *journal);
+void add_batch_file(ID3BATCH *batch, const char *path);
+void submit_batch_file(ID3BATCH *batch, const char *path);
+int check_batch_name(const char *name);
+int add_batch_path(ID3BATCH *batch, const char *path, int top);
+int add_batch_list(ID3BATCH *batch, const char *listname);
+int watch_batch(ID3BATCH *batch, const char *dir, const sigset_t *sigmask);
+int close_batch(ID3BATCH *batch);
+
+int open_uring_batch(ID3URINGBATCH *e, const ID3OPTION *option, int *failed, int *repair, ID3STATS *total, ID3CACHE *cache, ID3JOURNAL *journal);
+void add_uring_batch(ID3URINGBATCH *e, const char *path);
+void run_uring_batch(ID3URINGBATCH *e, int wait);
+void step_uring_slot(ID3URINGBATCH *e, ID3SLOT *slot, int res);
+void finish_uring_slot(ID3URINGBATCH *e, ID3SLOT *slot, int ret);
+void close_uring_batch(ID3URINGBATCH *e);
 
 
 
@@ -206,14 +225,138 @@ static char g_filename[FILENAME_MAX];
 
 // Usage
 void usage(const char *this) {
-	fprintf(stderr, "Usage: %s [option] filename\n", this);
+	fprintf(stderr, "Usage: %s [option] filename...\n", this);
 	fprintf(stderr, "  -r, --repetition : When APIC frame comes out two times or more, it is deleted.\n");
-	fprintf(stderr, "  -d FRAMETYPE, --delete FRAMETYPE : All frames of a specified type are deleted.\n");
+	fprintf(stderr, "  -d FRAMETYPE[,FRAMETYPE...], --delete FRAMETYPE[,...] : All frames of the specified types are deleted.\n");
+	fprintf(stderr, "                May be given more than once.\n");
+	fprintf(stderr, "  --rules FILE : Frame rules are read from FILE. One rule per line: delete|keep|patch FRAMETYPE...\n");
+	fprintf(stderr, "                ('#' starts a comment. A later rule for the same type wins, command line included.)\n");
+	fprintf(stderr, "  --dedup : APIC frames whose picture data is identical to another one are deleted, whatever their type.\n");
+	fprintf(stderr, "  --keep first|largest|smallest : Which APIC frame of duplicates (-r, --dedup) is kept. (default: first)\n");
+	fprintf(stderr, "  --max-apic-bytes N : APIC frames larger than N bytes (frame header included) are deleted.\n");
+	fprintf(stderr, "  --padding N : Rewritten tags get exactly N bytes of padding. (updates the extended header too)\n");
+	fprintf(stderr, "  --max-padding N : Padding larger than N bytes is cut to N when the tag is rewritten.\n");
+	fprintf(stderr, "                A file whose padding would change is rewritten. Both are ignored with -i.\n");
+	fprintf(stderr, "  --no-unsync : Unsynchronised tags are written without unsynchronisation. (-i always does so)\n");
 	fprintf(stderr, "  -v, --verbose : Verbose mode.\n");
+	fprintf(stderr, "  -i, --in-place : The tag is rewritten in place. Removed bytes become padding and no .bak is made.\n");
+	fprintf(stderr, "  --collapse : When the file itself is rewritten (-i, or a .bak made by reflink), whole filesystem blocks\n");
+	fprintf(stderr, "                of the removed bytes are cut out with fallocate(COLLAPSE_RANGE) instead of moving the data.\n");
+	fprintf(stderr, "                The rest becomes padding. Falls back to the usual way where unsupported.\n");
+	fprintf(stderr, "  -c, --check : Only the tag is read and no file is written. One line per file is printed:\n");
+	fprintf(stderr, "                clean|repair|error <TAB> ima_ge <TAB> repetition <TAB> delete <TAB> large <TAB> saved_bytes <TAB> filename\n");
+	fprintf(stderr, "                exit status: 0 all clean, 2 some files need repair, 1 error\n");
+	fprintf(stderr, "  -j N, --jobs N : Number of worker threads for batch mode. (default: number of CPUs)\n");
+	fprintf(stderr, "  --files0-from FILE : Read NUL-separated file names from FILE. ('-' is stdin)\n");
+	fprintf(stderr, "  --uring : Batch mode uses io_uring to overlap the I/O of many files.\n");
+	fprintf(stderr, "  --stats[=text|json] : Per-file and total timings of each phase and I/O counters are printed.\n");
+	fprintf(stderr, "  --cache FILE : Results are kept in FILE. Files unchanged since the last run are skipped without being opened.\n");
+	fprintf(stderr, "  --watch DIR : Keeps running and repairs *.mp3 files written or moved into DIR (recursive) until SIGINT/SIGTERM.\n");
+	fprintf(stderr, "                Other filenames are repaired once first. (filename may be omitted)\n");
+	fprintf(stderr, "  --journal FILE : The state of each file is logged to FILE. A run that was killed resumes from FILE\n");
+	fprintf(stderr, "                with the same command line. Half-written files are restored and repaired again.\n");
+	fprintf(stderr, "                FILE is removed when every file is done.\n");
+	fprintf(stderr, "  A directory is searched recursively for *.mp3 files.\n");
+	fprintf(stderr, "  '-' as the only filename reads stdin and writes the repaired file to stdout. (no seek, no .bak)\n");
 	exit(EXIT_FAILURE);
 }
 
 
+/* parse_id3_rules ****************************
+   J}؂̃t[IDꗗactionƂoptionɉ
+   ( "PRIV,GEOB,COMM,TXXX")
+
+   ߂lF(F0@sF-1)
+***********************************************/
+int parse_id3_rules(ID3OPTION *option, const char *list, int action) {
+	char id[ID3_FRAME_ID_SIZE + 1];
+	const char *p = list;
+	size_t len;
+
+	do {
+		len = strcspn(p, ",");
+		if (len != ID3_FRAME_ID_SIZE) return RET_ERROR;
+		memcpy(id, p, len);
+		id[len] = '\0';
+		if (add_id3_rule(option, id, action)) return RET_ERROR;
+		p += len;
+	} while (*p++ == ',');
+
+	return RET_OK;
+}
+
+
+/* load_id3_rules *****************************
+   opt [--rules FILE] ̃[t@Cǂ
+   1sɁu t[ID ...v (#ȍ~̓Rg)
+     delete PRIV GEOB
+     keep COMM
+     patch APIC
+    delete / keep / patch ̂ꂩ
+   ID̓R}hC܂߂Č̎w肪D悷
+
+   ߂lF(F0@sF-1)
+***********************************************/
+int load_id3_rules(ID3OPTION *option, const char *path) {
+	static const char *name[] = {"keep", "delete", "patch"}; // RULE_KEEP RULE_DELETE RULE_PATCH
+	char line[RULES_LINE_SIZE];
+	char *word, *save, *p;
+	int action, lineno = 0;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		fprintf(stderr, "file open error : %s\n", path);
+		return RET_ERROR;
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		lineno++;
+		p = strchr(line, '#');
+		if (p != NULL) *p = '\0';
+
+		word = strtok_r(line, " \t\r\n", &save);
+		if (word == NULL) continue;
+		for (action = 0; action < RULE_NAME_NUM; action++) {
+			if (0 == strcmp(word, name[action])) break;
+		}
+		if (action == RULE_NAME_NUM) goto LOAD_ID3_RULES_ERROR;
+
+		while ((word = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+			if (parse_id3_rules(option, word, action)) goto LOAD_ID3_RULES_ERROR;
+		}
+	}
+
+	fclose(fp);
+	return RET_OK;
+
+  LOAD_ID3_RULES_ERROR:
+	fprintf(stderr, "rules error : %s:%d\n", path, lineno);
+	fclose(fp);
+	return RET_ERROR;
+}
+
+
+/* parse_id3_padding **************************
+   opt [--padding] [--max-padding] [--max-apic-bytes] byteǂ
+   (^O̍őTCY܂)
+
+   ߂lF(F0@sF-1)
+***********************************************/
+int parse_id3_padding(const char *str, unsigned int *size) {
+	unsigned long n;
+	char *end;
+
+	errno = 0;
+	n = strtoul(str, &end, 10);
+	if ((errno != 0) || (end == str) || (*end != '\0') || (*str == '-')) return RET_ERROR;
+	if (n > ID3_TAG_MAXSIZE) return RET_ERROR;
+	*size = n;
+
+	return RET_OK;
+}
+
+
 /* main *************************************************************
     ID3 v2.3ł̂ݎgp\
     Œ̋@\Ȃߑ҂Ă͂ȂȂ
@@ -221,20 +364,74 @@ void usage(const char *this) {
   @\F
     1.APICt[MIMEwima ge/jpegƂȂĂ镨image/jpegƏC
 	2.^CvAPICt[ꍇ2ڈȍ~폜(opt [-r])
-	3.w肳ꂽ^Cṽt[폜(opt [-d FRAMETYPE])
-    1`3sセɔwb_TCỸTCYύXs
+	3.w肳ꂽ^Cṽt[폜(opt [-d FRAMETYPE,...] [--rules FILE])
+	4.摜f[^APICt[2ڈȍ~폜(opt [--dedup])
+	  24Ŏc opt [--keep first|largest|smallest] őI
+	5.N byte𒴂APICt[폜(opt [--max-apic-bytes N])
+    1`5sセɔwb_TCỸTCYύXs
+    opt [--padding N] [--max-padding N] ̏ꍇ͏^Opadding
+    N byte(N byte)ɂ
+    񓯊ꂽ^O͉ĉ͂A񓯊ďo
+    (opt [--no-unsync] ̏ꍇ͉܂܏o)
+    opt [-i] ̏ꍇ.bak炸Apadding̈ɉ񂵂
+    ^Ö݂̂㏑(wb_TCY͕ςȂ)
+    opt [--collapse] ̏ꍇ͌t@C鎞(-iAreflink.bak)A
+    ̂ubNPʂ̕fallocateŎ菜Af[^̈ړȂ
+    opt [-c] ̏ꍇ̓^ÖǂނŁACeo͂
+    (t@C݂̏▼OύX͈؍sȂ)
+    t@C "-" ݂̂łstdinǂ݁Astdout֏o
+
+    t@CAfBNgAopt [--files0-from] ̏ꍇ
+    ob`[hƂăXbhv[ŕɏ
+    opt [--uring] ̏ꍇio_uringŕt@CI/Od˂ď
+    opt [--watch DIR] ̏ꍇ͏I܂DIRȉĎA
+    ܂ꂽt@CXbhv[ŏ
+    opt [--journal FILE] ̏ꍇ̓t@C̏ԂFILEɋL^A
+    fs̋NőĊJ
 ********************************************************************/
 int main(int argc, char *argv[]) {
-	FILE *fpr = NULL;
-	FILE *fpw = NULL;
-	unsigned int headersize;
-	char filenamebak[FILENAME_MAX];
+	ID3OPTION option;
+	ID3JOB job;
+	ID3BATCH batch;
+	ID3STATS total;
+	ID3CACHE cache;
+	ID3CACHE *pcache = NULL;
+	struct stat st;
+	const char *files0from = NULL;
+	const char *cachefile = NULL;
+	const char *watchdir = NULL;
+	const char *journalfile = NULL;
+	ID3JOURNAL journal;
+	ID3JOURNAL *pjournal = NULL;
+	const char *path;
+	size_t resume = 0;
+	sigset_t sigmask;
+	int jobs = 0;
+	int uring = 0;
+	int i, ret;
 	
 	// getopt_long
 	struct option options[] = {
 		{"repetition", 0, 0, 0},
-		{"delete", 0, 0, 0},
+		{"delete", 1, 0, 0},
 		{"verbose", 0, 0, 0},
+		{"in-place", 0, 0, 0},
+		{"jobs", 1, 0, 0},
+		{"files0-from", 1, 0, 0},
+		{"uring", 0, 0, 0},
+		{"check", 0, 0, 0},
+		{"stats", 2, 0, 0},
+		{"cache", 1, 0, 0},
+		{"dedup", 0, 0, 0},
+		{"keep", 1, 0, 0},
+		{"rules", 1, 0, 0},
+		{"padding", 1, 0, 0},
+		{"max-padding", 1, 0, 0},
+		{"no-unsync", 0, 0, 0},
+		{"max-apic-bytes", 1, 0, 0},
+		{"watch", 1, 0, 0},
+		{"collapse", 0, 0, 0},
+		{"journal", 1, 0, 0},
 		{0, 0, 0, 0}
 	};
 	int opt;
@@ -246,11 +443,10 @@ int main(int argc, char *argv[]) {
 	}
 
 	// 
-	memset(g_filename, '\0', FILENAME_MAX);
-	memset(g_del_frametype, '\0', ID3_FRAME_ID_SIZE+1);
+	memset(&option, 0, sizeof(option));
 	
 	// option
-	while ((opt = getopt_long(argc, argv, "rd:v", options, &optindex)) != -1){
+	while ((opt = getopt_long(argc, argv, "rd:vicj:", options, &optindex)) != -1){
 		switch (opt){
 		case 0: //long opt
 #ifdef DEBUG_ON
@@ -258,32 +454,100 @@ int main(int argc, char *argv[]) {
 #endif
 			switch (optindex){
 			case LONGOPT_REPETITION:
-				g_flag |= OPTFLAG_REPETITION;
+				option.flag |= OPTFLAG_REPETITION;
 				break;
 			case LONGOPT_DELETE:
-				g_flag |= OPTFLAG_DELETE;
 				if (!optarg)
 					usage(argv[0]);
-				strncpy(g_del_frametype, optarg, ID3_FRAME_ID_SIZE);
+				if (parse_id3_rules(&option, optarg, RULE_DELETE)) usage(argv[0]);
 				break;
 			case LONGOPT_VERBOSE:
-				g_flag |= OPTFLAG_VERBOSE;
+				option.flag |= OPTFLAG_VERBOSE;
+				break;
+			case LONGOPT_INPLACE:
+				option.flag |= OPTFLAG_INPLACE;
+				break;
+			case LONGOPT_JOBS:
+				jobs = atoi(optarg);
+				if ((jobs < 1) || (jobs > POOL_WORKER_MAX)) usage(argv[0]);
+				break;
+			case LONGOPT_FILES0FROM:
+				files0from = optarg;
+				break;
+			case LONGOPT_URING:
+				uring = 1;
+				break;
+			case LONGOPT_CHECK:
+				option.flag |= OPTFLAG_CHECK;
+				break;
+			case LONGOPT_STATS:
+				if ((optarg == NULL) || (0 == strcmp(optarg, "text"))) option.stats = STATS_TEXT;
+				else if (0 == strcmp(optarg, "json")) option.stats = STATS_JSON;
+				else usage(argv[0]);
+				break;
+			case LONGOPT_CACHE:
+				cachefile = optarg;
+				break;
+			case LONGOPT_DEDUP:
+				option.flag |= OPTFLAG_DEDUP;
+				break;
+			case LONGOPT_KEEP:
+				if (0 == strcmp(optarg, "first")) option.keep = KEEP_FIRST;
+				else if (0 == strcmp(optarg, "largest")) option.keep = KEEP_LARGEST;
+				else if (0 == strcmp(optarg, "smallest")) option.keep = KEEP_SMALLEST;
+				else usage(argv[0]);
+				break;
+			case LONGOPT_RULES:
+				if (load_id3_rules(&option, optarg)) return EXIT_FAILURE;
+				break;
+			case LONGOPT_PADDING:
+				if (parse_id3_padding(optarg, &(option.padding))) usage(argv[0]);
+				option.flag |= OPTFLAG_PADDING;
+				break;
+			case LONGOPT_MAXPADDING:
+				if (parse_id3_padding(optarg, &(option.maxpadding))) usage(argv[0]);
+				option.flag |= OPTFLAG_MAXPADDING;
+				break;
+			case LONGOPT_NOUNSYNC:
+				option.flag |= OPTFLAG_NOUNSYNC;
+				break;
+			case LONGOPT_MAXAPIC:
+				if (parse_id3_padding(optarg, &(option.maxapic))) usage(argv[0]);
+				option.flag |= OPTFLAG_MAXAPIC;
+				break;
+			case LONGOPT_WATCH:
+				watchdir = optarg;
+				break;
+			case LONGOPT_COLLAPSE:
+				option.flag |= OPTFLAG_COLLAPSE;
+				break;
+			case LONGOPT_JOURNAL:
+				journalfile = optarg;
 				break;
 			default:
 				break;
 			}
 			break;
 		case 'r': // repetition opt
-			g_flag |= OPTFLAG_REPETITION;
+			option.flag |= OPTFLAG_REPETITION;
 			break;
 		case 'd': // delete opt
-			g_flag |= OPTFLAG_DELETE;
 			if (!optarg)
 				usage(argv[0]);
-			strncpy(g_del_frametype, optarg, ID3_FRAME_ID_SIZE);
+			if (parse_id3_rules(&option, optarg, RULE_DELETE)) usage(argv[0]);
 			break;
 		case 'v': // verbose opt
-			g_flag |= OPTFLAG_VERBOSE;
+			option.flag |= OPTFLAG_VERBOSE;
+			break;
+		case 'i': // in-place opt
+			option.flag |= OPTFLAG_INPLACE;
+			break;
+		case 'c': // check opt
+			option.flag |= OPTFLAG_CHECK;
+			break;
+		case 'j': // jobs opt
+			jobs = atoi(optarg);
+			if ((jobs < 1) || (jobs > POOL_WORKER_MAX)) usage(argv[0]);
 			break;
 		default:
 			usage(argv[0]);
@@ -291,674 +555,1320 @@ int main(int argc, char *argv[]) {
 		}
 	}
 #ifdef DEBUG_ON
-	printf("OPT = %02X\n", g_flag);
-	printf("OPTARG = %s\n", g_del_frametype);
+	printf("OPT = %03X\n", option.flag);
+	printf("RULES = %d\n", option.rulenum);
 #endif
 
+	if ((optind >= argc) && (files0from == NULL) && (watchdir == NULL)) usage(argv[0]); // to exit
+
+	// Ȏ
+	if (cachefile != NULL) {
+		if (open_id3_cache(&cache, cachefile, get_id3_cache_key(&option))) {
+			fprintf(stderr, "cache open error : %s\n", cachefile);
+			return EXIT_FAILURE;
+		}
+		pcache = &cache;
+	}
+
+	// O̎s̋L^ (IȂt@C͂ŏOɖ߂)
+	if (journalfile != NULL) {
+		if (open_id3_journal(&journal, journalfile, get_id3_journal_key(&option))) {
+			fprintf(stderr, "journal open error : %s\n", journalfile);
+			ret = RET_ERROR;
+			goto MAIN_EXIT;
+		}
+		pjournal = &journal;
+		if ((option.flag & OPTFLAG_VERBOSE) && (journal.num > 0)) {
+			fprintf(stderr, "journal : %zu of %zu files are left\n", journal.left, journal.num);
+		}
+	}
+
+	// t@C1Ȃ炻̂܂܏
+	if ((optind + 1 == argc) && (files0from == NULL) && (watchdir == NULL) && (journalfile == NULL) && (jobs == 0) && !uring
+		&& ((0 != stat(argv[optind], &st)) || !S_ISDIR(st.st_mode))) {
+		memset(&job, 0, sizeof(job));
+		job.option = &option;
+		job.log = stdout;
+		job.cache = pcache;
+		// stdoutɂ̓t@CôŁAverbosestderr
+		if ((0 == strcmp(argv[optind], STREAM_NAME)) && !(option.flag & OPTFLAG_CHECK)) job.log = stderr;
+		strncpy(job.filename, argv[optind], FILENAME_MAX - 1);
+		memset(&total, 0, sizeof(total));
+		job.total = &total;
+		ret = repair_id3_file(&job);
+		if (option.stats != STATS_OFF) print_id3_stats(job.log, NULL, &total, option.stats);
+		goto MAIN_EXIT;
+	}
+
+	// ob`[h
+	if (jobs == 0) {
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+		if (jobs < 1) jobs = 1;
+		if (jobs > POOL_WORKER_MAX) jobs = POOL_WORKER_MAX;
+	}
+	// --collapseprocess_id3_fileōŝŁAio_uringGW͎gȂ
+	if (uring && (option.flag & OPTFLAG_COLLAPSE)) {
+		if (option.flag & OPTFLAG_VERBOSE) fprintf(stderr, "--collapse uses the thread pool.\n");
+		uring = 0;
+	}
+	if (watchdir != NULL) {
+		// Ď͏IVOisignalfdŎ󂯂̂ŁAworker܂߂Ď~߂Ă
+		sigemptyset(&sigmask);
+		sigaddset(&sigmask, SIGINT);
+		sigaddset(&sigmask, SIGTERM);
+		pthread_sigmask(SIG_BLOCK, &sigmask, NULL);
+		if (uring && (option.flag & OPTFLAG_VERBOSE)) fprintf(stderr, "--watch uses the thread pool.\n");
+		uring = 0;
+	}
+	if (open_batch(&batch, &option, jobs, uring, pcache, pjournal)) {
+		fprintf(stderr, "thread pool error\n");
+		ret = RET_ERROR;
+		goto MAIN_EXIT;
+	}
+
+	// OIȂt@Cɐς݁A񋓂IĂΗ񋓂Ȃ
+	if (pjournal != NULL) {
+		while ((path = next_id3_journal(pjournal, &resume)) != NULL) submit_batch_file(&batch, path);
+	}
+	if ((pjournal == NULL) || !pjournal->scanned) {
+		for (i = optind; i < argc; i++) add_batch_path(&batch, argv[i], 1);
+		if (files0from != NULL) add_batch_list(&batch, files0from);
+	}
+	if ((pjournal != NULL) && scan_id3_journal(pjournal)) {
+		fprintf(stderr, "journal write error : %s\n", journalfile);
+		__atomic_add_fetch(&batch.failed, 1, __ATOMIC_SEQ_CST);
+	}
+	if ((watchdir != NULL) && watch_batch(&batch, watchdir, &sigmask)) {
+		fprintf(stderr, "watch error : %s\n", watchdir);
+		__atomic_add_fetch(&batch.failed, 1, __ATOMIC_SEQ_CST);
+	}
+
+	ret = close_batch(&batch);
+
+  MAIN_EXIT:
+	// ȂĂǋL͎cĂ
+	if ((pcache != NULL) && close_id3_cache(pcache)) fprintf(stderr, "cache write error : %s\n", cachefile);
+	if ((pjournal != NULL) && close_id3_journal(pjournal)) fprintf(stderr, "journal write error : %s\n", journalfile);
+	if (ret == RET_FAILURE) return EXIT_REPAIR;
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+/* repair_id3_file ****************************
+   job->filenamẽt@C1C
+   opt [--stats] łΌvl1so͂A
+   job->totalɑ
+
+   ߂lFprocess_id3_fileƓ
+***********************************************/
+int repair_id3_file(ID3JOB *job) {
+	ID3STATS stats;
+	int ret;
+
+	if (job->option->stats == STATS_OFF) {
+		job->stats = NULL;
+		return process_id3_file(job);
+	}
+
+	job->stats = &stats;
+	begin_id3_stats(&stats);
+	ret = process_id3_file(job);
+	end_id3_stats(&stats);
+	print_id3_stats(job->log, job->filename, &stats, job->option->stats);
+	if (job->total != NULL) add_id3_stats(job->total, &stats);
+	job->stats = NULL;
+
+	return ret;
+}
+
+
+/* process_id3_file ***************************
+   job->filenamẽt@C1C
+   opt [--check] ł΃^ÖǂނŁA
+   Ce1so͂
+
+   ߂lF(F0@sF-1)
+           --checkŏCKvȃt@C1
+***********************************************/
+int process_id3_file(ID3JOB *job) {
+	const ID3OPTION *option = job->option;
+	FILE *fpr = NULL;
+	FILE *fpw = NULL;
+	ID3TAG tag;
+	unsigned int headersize;
+	unsigned long long taghash = 0;
+	char filenamebak[FILENAME_MAX];
+	int ret;
+
+	memset(&tag, 0, sizeof(tag));
+
+	if (0 == strcmp(job->filename, STREAM_NAME)) return process_id3_stream(job);
+
+	// O񂩂ςĂȂΊJɏI
+	if (skip_id3_cache(job, 0, &ret)) return ret;
+
 	// file open
-	if (optind >= argc) usage(argv[0]); // to exit
-	else {
-		fpr = fopen(argv[optind], "rb");
-		if (fpr == NULL) {
-			fprintf(stderr, "file open error : %s\n", argv[optind]);
-			usage(argv[0]);
+	fpr = fopen(job->filename, "rb");
+	if (fpr == NULL) {
+		fprintf(stderr, "file open error : %s\n", job->filename);
+		goto REPAIR_ID3_FILE_FAILURE;
+	}
+
+	// ^Oǂݍ݁AC̃TCY擾
+	// in-placeł͓t@Cɏނ̂mmapgȂ
+	start_id3_stats(job->stats, STATS_PARSE);
+	ret = read_id3_tag(&tag, fileno(fpr), (option->flag & OPTFLAG_INPLACE) ? READER_BUF : READER_MMAP);
+	stop_id3_stats(job->stats, STATS_PARSE);
+	if (ret) goto REPAIR_ID3_FILE_FAILURE;
+	tag.stats = job->stats;
+
+	// mtimeςĂĂ^OłΑǑʂg
+	if (job->cache != NULL) {
+		taghash = hash_id3_data(tag.reader.base, tag.tagsize, 0);
+		if (skip_id3_cache(job, taghash, &ret)) {
+			free_id3_tag(&tag);
+			fclose(fpr);
+			return ret;
 		}
 	}
-	strncpy(g_filename, argv[optind], FILENAME_MAX);
 
-	// C̃TCY擾
-	headersize = get_id3_repair_size(fpr);
+	headersize = get_id3_repair_size(&tag, option);
 #ifdef DEBUG_ON
 	printf("returnsize = %08X\n", headersize);
 #endif
-	if (0 == headersize) goto MAIN_EXIT_SUCCESS;
-	if (RET_ERROR == headersize) goto MAIN_EXIT_FAILURE;
+
+	// Ceo͂邾ŏ݂͈؍sȂ
+	if (option->flag & OPTFLAG_CHECK) {
+		if (RET_ERROR == headersize) goto REPAIR_ID3_FILE_FAILURE;
+		save_id3_cache(job, taghash, headersize, &(tag.report));
+		print_id3_check(job, (0 == headersize) ? CHECK_CLEAN : CHECK_REPAIR, &(tag.report));
+		free_id3_tag(&tag);
+		fclose(fpr);
+		return (0 == headersize) ? RET_OK : RET_FAILURE;
+	}
+
+	if (0 == headersize) goto REPAIR_ID3_FILE_SUCCESS;
+	if (RET_ERROR == headersize) goto REPAIR_ID3_FILE_FAILURE;
+
+	// ^Ö悾㏑
+	if (option->flag & OPTFLAG_INPLACE) {
+		if (journal_id3_file(job, fileno(fpr), JOURNAL_INPLACE, &tag)) goto REPAIR_ID3_FILE_FAILURE;
+		fclose(fpr);
+		fpr = NULL;
+		fpw = fopen(job->filename, "r+b");
+		if (fpw == NULL) {
+			fprintf(stderr, "file open error : %s\n", job->filename);
+			goto REPAIR_ID3_FILE_FAILURE;
+		}
+		if (option->flag & OPTFLAG_COLLAPSE) {
+			ret = repair_id3_tag_collapse(fpw, &tag, headersize, job);
+			if (RET_ERROR == ret) goto REPAIR_ID3_FILE_FAILURE;
+			if (RET_OK == ret) goto REPAIR_ID3_FILE_SUCCESS;
+		}
+		if (repair_id3_tag_inplace(fpw, &tag, headersize, job)) goto REPAIR_ID3_FILE_FAILURE;
+		goto REPAIR_ID3_FILE_SUCCESS;
+	}
+
+	if (FILENAME_MAX <= snprintf(filenamebak, FILENAME_MAX, "%s.bak", job->filename)) goto REPAIR_ID3_FILE_FAILURE;
+	if (journal_id3_file(job, fileno(fpr), JOURNAL_BACKUP, &tag)) goto REPAIR_ID3_FILE_FAILURE;
+
+	// $1.bakreflinkō쐬ł΁A^O.bakQƂ
+	// filenamẽt@Ĉ܂܏
+	start_id3_stats(job->stats, STATS_BACKUP);
+	if (RET_OK == clone_id3_backup(fileno(fpr), filenamebak)) {
+		stop_id3_stats(job->stats, STATS_BACKUP);
+		fclose(fpr);
+		fpr = fopen(filenamebak, "rb");
+		if (fpr == NULL) {
+			fprintf(stderr, "file open error : %s\n", filenamebak);
+			goto REPAIR_ID3_FILE_FAILURE;
+		}
+		if (move_id3_tag(&tag, fileno(fpr))) goto REPAIR_ID3_FILE_FAILURE;
+		fpw = fopen(job->filename, "r+b");
+		if (fpw == NULL) {
+			fprintf(stderr, "file open error : %s\n", job->filename);
+			goto REPAIR_ID3_FILE_FAILURE;
+		}
+		print_id3_backup(job, filenamebak, BACKUP_REFLINK);
+
+		// ubNPʂŎ菜΃f[^̈͂̂܂
+		if (option->flag & OPTFLAG_COLLAPSE) {
+			ret = repair_id3_tag_collapse(fpw, &tag, headersize, job);
+			if (RET_ERROR == ret) goto REPAIR_ID3_FILE_FAILURE;
+			if (RET_OK == ret) goto REPAIR_ID3_FILE_SUCCESS;
+		}
+
+		// ^OCAk񂾕؂l߂
+		if (repair_id3_tag(fpw, fpr, &tag, headersize, job)) goto REPAIR_ID3_FILE_FAILURE;
+		if (fflush(fpw)) goto REPAIR_ID3_FILE_FAILURE;
+		if (ftruncate(fileno(fpw), ftello(fpw))) goto REPAIR_ID3_FILE_FAILURE;
+		goto REPAIR_ID3_FILE_SUCCESS;
+	}
 	fclose(fpr); // Ut@CN[Y
+	fpr = NULL;
 
 	// filenamẽt@C$1.bakɖOύXfilenameŐVKt@C쐬
-	strncpy(filenamebak, argv[optind], FILENAME_MAX);
-	strncat(filenamebak, ".bak", 4);
-	if (rename(argv[optind], filenamebak)) goto MAIN_EXIT_FAILURE;
+	ret = rename(job->filename, filenamebak);
+	stop_id3_stats(job->stats, STATS_BACKUP);
+	if (ret) goto REPAIR_ID3_FILE_FAILURE;
+	print_id3_backup(job, filenamebak, BACKUP_RENAME);
 
 	fpr = fopen(filenamebak, "rb");
 	if (fpr == NULL) {
 		fprintf(stderr, "file open error : %s\n", filenamebak);
-		goto MAIN_EXIT_FAILURE;
+		goto REPAIR_ID3_FILE_FAILURE;
 	}
-	fpw = fopen(argv[optind], "wb");
+	fpw = fopen(job->filename, "wb");
 	if (fpw == NULL) {
-		fprintf(stderr, "file open error : %s\n", argv[optind]);
-		goto MAIN_EXIT_FAILURE;
+		fprintf(stderr, "file open error : %s\n", job->filename);
+		goto REPAIR_ID3_FILE_FAILURE;
 	}
 
 	// ^OC
-	if (repair_id3_tag(fpw, fpr, headersize)) goto MAIN_EXIT_FAILURE;
+	if (repair_id3_tag(fpw, fpr, &tag, headersize, job)) goto REPAIR_ID3_FILE_FAILURE;
 
 
-  MAIN_EXIT_SUCCESS:
+  REPAIR_ID3_FILE_SUCCESS:
+	free_id3_tag(&tag);
 	if(fpr != NULL) fclose(fpr);
-	if(fpw != NULL) fclose(fpw);
-	return EXIT_SUCCESS;
+	// opt [--journal] łENDL^Oɏ݂m肳
+	if ((fpw != NULL) && (job->journal != NULL)
+		&& sync_id3_file(job, fpw, !(option->flag & OPTFLAG_INPLACE))) {
+		fclose(fpw);
+		return RET_ERROR;
+	}
+	if(fpw != NULL && fclose(fpw)) return RET_ERROR;
+	// C̃^O͓ǂłȂ̂hash͕sƂ
+	save_id3_cache(job, (0 == headersize) ? taghash : 0, 0, NULL);
+	return RET_OK;
 	
-  MAIN_EXIT_FAILURE:
+  REPAIR_ID3_FILE_FAILURE:
+	if (option->flag & OPTFLAG_CHECK) print_id3_check(job, CHECK_ERROR, NULL);
+	free_id3_tag(&tag);
 	if(fpr != NULL) fclose(fpr);
 	if(fpw != NULL) fclose(fpw);
-	return EXIT_FAILURE;
+	return RET_ERROR;
 }
 
 
-/* fpstr **********************************************
-   Xg[str(f[^)To
+/* process_id3_stream *************************
+   stdiñt@CCstdout֏o
+   ^Ö悾ɓǂ݁Af[^̈seek
+   ̂܂܎󂯓n̂ŁApCv̓rŎg
+   ID3v2.3^OA^OĂďCłȂ
+   ǂ񂾕܂߂Ă̂܂܏o (--checkł͏oȂ)
+   (opt [--cache] ͎gȂ)
 
-   npos: 0ȊOZbgnposʒu܂łǂݍ݂sȂ
-   ߂lF0AȂG[łȊO
-   ӁF͕Kǂݏos
-*******************************************************/
-int fpstr(FILE *fp, const char *str, fpos_t npos) {
-	char strbuf[STR_BUF];
-	fpos_t pos;
+   ߂lFprocess_id3_fileƓ
+***********************************************/
+int process_id3_stream(ID3JOB *job) {
+	const ID3OPTION *option = job->option;
+	ID3TAG tag;
+	ID3READER *rd = &(tag.reader);
+	unsigned int headersize;
+	int ret;
 
-	memset(strbuf, '\0', STR_BUF);
+	memset(&tag, 0, sizeof(tag));
+	open_id3_reader_stream(rd, STDIN_FILENO);
 
-	if (fp == NULL) return RET_ERROR;
-	if (strlen(str) > STR_BUF) return RET_ERROR;
+	// wb_Ɋm߂ (parse_id3_tag͎sĂstreamreader͎c)
+	start_id3_stats(job->stats, STATS_PARSE);
+	ret = read_id3_header(&(tag.header), rd);
+	if ((RET_OK == ret) && check_id3_tag(&(tag.header))) ret = parse_id3_tag(&tag);
+	else ret = RET_FAILURE;
+	stop_id3_stats(job->stats, STATS_PARSE);
+	if (ret == RET_ERROR) goto PROCESS_ID3_STREAM_PASS;
+	tag.stats = job->stats;
 
-#ifdef DEBUG_ON
-	printf("checkpoint 2 str = %s\n", str);
-#endif
-	while (0 < fread(strbuf, 1, 1, fp)) {
-		if (strbuf[0] == str[0]){
-			if (strlen(str)-1 > fread(strbuf+1, 1, strlen(str)-1, fp)) return RET_ERROR;
-#ifdef DEBUG_ON
-			printf("checkpoint 3 strbuf = %s\n", strbuf);
-#endif
-			if (0 == strncmp(strbuf, str, strlen(str))) {
-				if (fseek(fp, -(strlen(str)), SEEK_CUR)) return RET_ERROR;
-				else return RET_OK;
-			}
-			if (fseek(fp, -(strlen(str)-1), SEEK_CUR)) return RET_ERROR;
-		}
-		if (fgetpos(fp, &pos)) return RET_ERROR;
-		if ((npos > 0) && (pos > npos)) break;
+	if (ret == RET_FAILURE) {
+		fprintf(stderr, "It doesn't correspond to this file format. Please let me read the file of the ID3v2.3 form. \n");
+		goto PROCESS_ID3_STREAM_PASS;
 	}
-#ifdef DEBUG_ON
-	printf("fpos = %08X\n", (unsigned int)pos);
-#endif
-	return RET_FAILURE;
-}
 
+	headersize = get_id3_repair_size(&tag, option);
+	if (RET_ERROR == headersize) goto PROCESS_ID3_STREAM_PASS;
 
-/* fcopy **********************************************
-   fpr̒gfpwɃRs[B
+	if (option->flag & OPTFLAG_CHECK) {
+		print_id3_check(job, (0 == headersize) ? CHECK_CLEAN : CHECK_REPAIR, &(tag.report));
+		free_id3_tag(&tag);
+		return (0 == headersize) ? RET_OK : RET_FAILURE;
+	}
 
-   ߂lFG[-1
-*******************************************************/
-int fcopy(FILE *fpw, FILE *fpr) {
-	size_t n;
-	char buf[READ_BUF_SIZE];
+	if (repair_id3_stream(stdout, STDIN_FILENO, &tag, headersize, job)) goto PROCESS_ID3_STREAM_FAILURE;
+	free_id3_tag(&tag);
+	return (fflush(stdout)) ? RET_ERROR : RET_OK;
 
-	if ((fpr == NULL) || (fpw == NULL)) return RET_ERROR;
+  PROCESS_ID3_STREAM_PASS:
+	// CłȂΓǂ񂾕܂߂Ă̂܂܏o (IR[h1)
+	if (!(option->flag & OPTFLAG_CHECK)) {
+		if ((rd->size != fwrite(rd->base, 1, rd->size, stdout)) || fdcopy(stdout, STDIN_FILENO, job->stats)) {
+			fprintf(stderr, "write error : stdout\n");
+		}
+	}
 
-	while (1) {
-		n = fread(buf, sizeof(char), READ_BUF_SIZE, fpr);
+  PROCESS_ID3_STREAM_FAILURE:
+	if (option->flag & OPTFLAG_CHECK) print_id3_check(job, CHECK_ERROR, NULL);
+	free_id3_tag(&tag);
+	return RET_ERROR;
+}
 
-		if (n != READ_BUF_SIZE) {
-			if ((n <= 0) || (n > READ_BUF_SIZE)) break;
-			if (n != fwrite(buf, sizeof(char), n, fpw)) return RET_ERROR;
-			break;
+
+/* clone_id3_backup ***************************
+   fd̃t@Creflink(FICLONE)bak쐬
+   reflinkłȂt@CVXeł΍쐬Ȃ
+   (ŌɎsfoCX͊oĂAȍ~͎Ȃ)
+
+   ߂lF쐬0 쐬Ȃ1
+***********************************************/
+int clone_id3_backup(int fd, const char *bak) {
+#ifdef FICLONE
+	static dev_t noreflink = 0;  // atomicœǂݏ
+	struct stat st;
+	int fdb;
+
+	if (fstat(fd, &st) || (! S_ISREG(st.st_mode))) return RET_FAILURE;
+	if (st.st_dev == __atomic_load_n(&noreflink, __ATOMIC_RELAXED)) return RET_FAILURE;
+
+	// .bakrenameƓu
+	if (unlink(bak) && (errno != ENOENT)) return RET_FAILURE;
+	fdb = open(bak, O_WRONLY | O_CREAT | O_EXCL, st.st_mode & 07777);
+	if (fdb < 0) return RET_FAILURE;
+
+	if (ioctl(fdb, FICLONE, fd)) {
+		if ((errno == EOPNOTSUPP) || (errno == ENOTTY) || (errno == EXDEV) || (errno == EINVAL)) {
+			__atomic_store_n(&noreflink, st.st_dev, __ATOMIC_RELAXED);
 		}
-		else
-			if (n != fwrite(buf, sizeof(char), n, fpw)) return RET_ERROR;
+		close(fdb);
+		unlink(bak);
+		return RET_FAILURE;
 	}
 
+	if (close(fdb)) {
+		unlink(bak);
+		return RET_FAILURE;
+	}
 	return RET_OK;
+#else
+	return RET_FAILURE;
+#endif
 }
 
 
-/* fncopy *********************************************
-   fpr̒g n byte fpwɃRs[B
+/* journal_id3_file ***************************
+   opt [--journal] fd̃t@Cn߂邱ƂL^
+   JOURNAL_INPLACEłΌ̃^ÖL^
+   (L^fsync܂Ŗ߂Ȃ)
 
-   ߂lFG[-1
-*******************************************************/
-int fncopy(FILE *fpw, FILE *fpr, size_t n) {
-	int i;
-	char buf;
-
-	if ((fpr == NULL) || (fpw == NULL)) return RET_ERROR;
-
-	for (i = 0; i < n; i++) {
-		if (1 != fread(&buf, sizeof(char), 1, fpr)) return RET_ERROR;
-		if (1 != fwrite(&buf, sizeof(char), 1, fpw)) return RET_ERROR;
+   ߂lF(F0@sF-1)
+***********************************************/
+int journal_id3_file(ID3JOB *job, int fd, int method, const ID3TAG *tag) {
+	struct stat st;
+	const unsigned char *data = NULL;
+
+	if (job->journal == NULL) return RET_OK;
+	if (method == JOURNAL_INPLACE) data = tag->reader.base;
+	if (fstat(fd, &st) || begin_id3_journal(job->journal, job->filename, method, &st, data, tag->tagsize)) {
+		fprintf(stderr, "%s : journal write error\n", job->filename);
+		return RET_ERROR;
 	}
 
 	return RET_OK;
 }
 
 
-/* read_id3_header **************
-   headerɊef[^ǂݍ
+/* sync_id3_file ******************************
+   opt [--journal] ŏfpfsync
+   dirł.bakƐVt@C̃Ggm肳
 
-   ߂lFł0
-   ӁFread֐fposړ
-*********************************/
-int read_id3_header(ID3HEADER *header, FILE *fp) {
-	if (fp == NULL) return RET_ERROR;
+   ߂lF(F0@sF-1)
+***********************************************/
+int sync_id3_file(ID3JOB *job, FILE *fp, int dir) {
+	int fd, ret;
+
+	if (fflush(fp) || fsync(fileno(fp))) goto SYNC_ID3_FILE_ERROR;
+	if (dir) {
+		fd = open_id3_journal_dir(job->filename);
+		if (fd < 0) goto SYNC_ID3_FILE_ERROR;
+		ret = fsync(fd);
+		close(fd);
+		if (ret) goto SYNC_ID3_FILE_ERROR;
+	}
+	return RET_OK;
 
-	// id3
-	if (0 >= fread(header->id3, sizeof(header->id3), 1, fp)) return RET_ERROR;
+  SYNC_ID3_FILE_ERROR:
+	fprintf(stderr, "%s : sync error\n", job->filename);
+	return RET_ERROR;
+}
 
-	// version
-	if (0 >= fread(header->version, sizeof(header->version), 1, fp)) return RET_ERROR;
 
-	// flag
-	if (0 >= fread(&(header->flag), sizeof(header->flag), 1, fp)) return RET_ERROR;
+/* print_id3_backup ***************************
+   opt [-v] ̏ꍇ.bak̍쐬@o͂
+***********************************************/
+void print_id3_backup(const ID3JOB *job, const char *bak, int strategy) {
+	if (! (job->option->flag & OPTFLAG_VERBOSE)) return;
 
-	// size
-	if (0 >= fread(&(header->size), FOUR_BYTE, 1, fp)) return RET_ERROR;
+	fprintf(job->log, "%s : backup %s (%s)\n", job->filename, bak,
+			(strategy == BACKUP_REFLINK) ? "reflink" : "rename");
+}
 
-	// sizesynchsafeƓ`ł邽ߕϊ
-	header->size = FROM_SYNCHSAFE(header->size);
 
-#ifdef DEBUG_ON
-	printf("id3 = %c%c%c\n", header->id3[0], header->id3[1], header->id3[2]);
-	printf("version = %02X%02X\n", header->version[0], header->version[1]);
-	printf("flag = %02X\n", header->flag);
-	printf("size = %08X\n", header->size);
-	printf("size(original) = %08X\n", REVERSE_ENDIAN(TO_SYNCHSAFE(header->size)));
-#endif
+/* print_id3_check ****************************
+   opt [--check] ̌ʂ^u؂1so͂
+      ima_geC dAPIC 폜t[ 傫APIC 팸byte t@C
+   Ԃ clean / repair / error ̂ꂩ
+***********************************************/
+void print_id3_check(const ID3JOB *job, int status, const ID3REPORT *report) {
+	static const char *name[] = {"clean", "repair", "error"};
+	ID3REPORT empty;
 
-	return RET_OK;
+	if (report == NULL) {
+		memset(&empty, 0, sizeof(empty));
+		report = &empty;
+	}
+	fprintf(job->log, "%s\t%u\t%u\t%u\t%u\t%u\t%s\n", name[status],
+			report->mime, report->repetition, report->del, report->large, report->saved, job->filename);
 }
 
 
-/* read_id3_extheader **************
-   headerɊef[^ǂݍ
+/* skip_id3_cache *****************************
+   opt [--cache] őǑʂgΏȂ
+   taghash: 0łstatŔf (t@CJO)
+   Csṽt@CƁA--checkł͑ȌCe
+   ̂܂܏o͂t@CȂ
 
-   ߂lFł0
-   ӁFread֐fposړ
-************************************/
-int read_id3_extheader(ID3EXTHEADER *header, FILE *fp) {
-	if (fp == NULL) return RET_ERROR;
+   ߂lFȂꍇ1 (*retɏʂ)
+***********************************************/
+int skip_id3_cache(ID3JOB *job, unsigned long long taghash, int *ret) {
+	const ID3OPTION *option = job->option;
+	ID3CACHEREC rec;
+	struct stat st;
+
+	if (job->cache == NULL) return 0;
+	if (stat(job->filename, &st)) return 0;
+	if (CACHE_MISS == lookup_id3_cache(job->cache, &st, taghash, &rec)) return 0;
+
+	if (option->flag & OPTFLAG_CHECK) {
+		print_id3_check(job, (0 == rec.headersize) ? CHECK_CLEAN : CHECK_REPAIR, &(rec.report));
+		*ret = (0 == rec.headersize) ? RET_OK : RET_FAILURE;
+	}
+	else if (0 == rec.headersize) {
+		if (option->flag & OPTFLAG_VERBOSE) fprintf(job->log, "%s : clean (cache)\n", job->filename);
+		*ret = RET_OK;
+	}
+	else return 0;
 
-	// size
-	if (0 >= fread(&(header->size), FOUR_BYTE, 1, fp)) return RET_ERROR;
+	// ^O̓eňvꍇ́Astatňv悤ɂ
+	if (taghash != 0) update_id3_cache(job->cache, &st, taghash, rec.headersize, &(rec.report));
+	return 1;
+}
 
-	// flag
-	if (0 >= fread(header->flag, sizeof(header->flag), 1, fp)) return RET_ERROR;
 
-	// padding_size
-	if (0 >= fread(&(header->padding_size), FOUR_BYTE, 1, fp)) return RET_ERROR;
+/* save_id3_cache *****************************
+   opt [--cache] job->filenamȅʂL^
+   sĂ̂͐Ƃ
+***********************************************/
+void save_id3_cache(ID3JOB *job, unsigned long long taghash, unsigned int headersize, const ID3REPORT *report) {
+	struct stat st;
 
-	// crctO`FbN
-	if (header->flag[0] & EXT_FLAG_CRC) {
-		// crc ǂݍ
-		if (0 >= fread(header->crc, sizeof(header->crc), 1, fp)) return RET_ERROR;
+	if (job->cache == NULL) return;
+	if (stat(job->filename, &st) || update_id3_cache(job->cache, &st, taghash, headersize, report)) {
+		fprintf(stderr, "%s : cache update failed\n", job->filename);
 	}
+}
 
-	// size,padding_sizerbOGfBÂ߃gGfBAɕϊ
-	header->size = REVERSE_ENDIAN(header->size);
-	header->padding_size = REVERSE_ENDIAN(header->padding_size);
 
-#ifdef DEBUG_ON
-	printf("size = %08X\n", header->size);
-	printf("size(original) = %08X\n", REVERSE_ENDIAN(header->size));
-	printf("extflag = %02X%02X\n", header->flag[0], header->flag[1]);
-	printf("padding_size = %08X\n", header->padding_size);
-	printf("padding_size(original) = %08X\n", REVERSE_ENDIAN(header->padding_size));
-	printf("crc = %c%c%c%c\n", header->crc[0], header->crc[1], header->crc[2], header->crc[3]);
-#endif
+/* batch_worker *******************************
+   Xbhv[workerĂ΂At@C1
+   verboseo͂worker̃obt@ɒ߂ĂA
+   ʂ𒴂܂Ƃ߂ďo͂
+***********************************************/
+void batch_worker(void *item, int worker, void *arg) {
+	ID3BATCH *batch = arg;
+	ID3WORKER *w = &(batch->worker[worker]);
+	ID3JOB job;
+	int ret;
+
+	memset(&job, 0, sizeof(job));
+	job.option = batch->option;
+	job.log = w->log;
+	job.total = &(w->stats);
+	job.cache = batch->cache;
+	job.journal = batch->journal;
+	strncpy(job.filename, item, FILENAME_MAX - 1);
+	free(item);
+
+	ret = repair_id3_file(&job);
+	if ((job.journal != NULL) && end_id3_journal(job.journal, job.filename, ret)) {
+		fprintf(stderr, "%s : journal write error\n", job.filename);
+	}
+	if (ret == RET_FAILURE) {
+		__atomic_add_fetch(&batch->repair, 1, __ATOMIC_SEQ_CST);
+	}
+	else if (ret) {
+		fprintf(stderr, "%s : repair failed\n", job.filename);
+		__atomic_add_fetch(&batch->failed, 1, __ATOMIC_SEQ_CST);
+	}
 
-	return RET_OK;
+	if ((w->log != stdout) && (batch->flushlog || (ftello(w->log) >= BATCH_LOG_FLUSH_SIZE))) flush_batch_log(batch, w);
 }
 
 
-/* read_id3_frame_header *********************
-   headerɊef[^ǂݍ
+/* flush_batch_log ****************************
+   workerverboseo̓obt@Wo͂ɏo
+***********************************************/
+void flush_batch_log(ID3BATCH *batch, ID3WORKER *w) {
+	off_t len;
 
-   ߂lFł0
-   ӁFread֐fposړ
-**********************************************/
-int read_id3_frame_header(ID3FRAMEHEADER *header, FILE *fp) {
-	if (fp == NULL) return RET_ERROR;
+	if (w->log == stdout) return;
+	len = ftello(w->log);
+	if (len <= 0) return;
+	fflush(w->log);
 
-	// id
-	if (0 >= fread(header->id, sizeof(header->id), 1, fp)) return RET_ERROR;
+	pthread_mutex_lock(&batch->outlock);
+	fwrite(w->logbuf, 1, len, stdout);
+	fflush(stdout);
+	pthread_mutex_unlock(&batch->outlock);
 
-	// size
-	if (0 >= fread(&(header->size), FOUR_BYTE, 1, fp)) return RET_ERROR;
+	fseeko(w->log, 0, SEEK_SET);
+}
 
-	// flag
-	if (0 >= fread(&(header->flag), sizeof(header->flag), 1, fp)) return RET_ERROR;
 
-	// sizerbOGfBÂ߃gGfBAɕϊ
-	header->size = REVERSE_ENDIAN(header->size);
-
-#ifdef DEBUG_ON
-	printf("id = %c%c%c%c\n", header->id[0], header->id[1], header->id[2], header->id[3]);
-	printf("size = %08X\n", header->size);
-	printf("size(original) = %08X\n", REVERSE_ENDIAN(header->size));
-	printf("flag = %02X%02X\n", header->flag[0], header->flag[1]);
-#endif
-
-	return RET_OK;
-}
+/* open_batch *********************************
+   jobsworkerŃob`Jn
+   uringw肳io_uringGWgA
+   gȂ΃Xbhv[ŏ
 
+   ߂lF0 G[-1
+***********************************************/
+int open_batch(ID3BATCH *batch, const ID3OPTION *option, int jobs, int uring, ID3CACHE *cache, ID3JOURNAL *journal) {
+	int i;
 
-/* write_id3 header **************
-   ߂lF0 G[1
-*****************************************/
-int write_id3_header(const ID3HEADER *header, FILE *fp) {
-	unsigned int headersize;
+	memset(batch, 0, sizeof(*batch));
+	batch->option = option;
+	batch->cache = cache;
+	batch->journal = journal;
+
+	// io_uringGW
+	if (uring) {
+		batch->uring = malloc(sizeof(ID3URINGBATCH));
+		if ((batch->uring != NULL) && (0 == open_uring_batch(batch->uring, option, &(batch->failed), &(batch->repair), &(batch->stats), cache, journal))) return RET_OK;
+		free(batch->uring);
+		batch->uring = NULL;
+		if (option->flag & OPTFLAG_VERBOSE) fprintf(stderr, "io_uring is not available. The thread pool is used.\n");
+	}
 
-	if (fp == NULL) return RET_ERROR;
+	batch->num = jobs;
+	batch->worker = calloc(jobs, sizeof(ID3WORKER));
+	if (batch->worker == NULL) return RET_ERROR;
+	pthread_mutex_init(&batch->outlock, NULL);
 
-	// synchsafe`ɕϊ
-	headersize = TO_SYNCHSAFE(header->size);
+	for (i = 0; i < jobs; i++) {
+		batch->worker[i].log = open_memstream(&(batch->worker[i].logbuf), &(batch->worker[i].logsize));
+		if (batch->worker[i].log == NULL) batch->worker[i].log = stdout;
+	}
 
-	if (1 != fwrite(header->id3, sizeof(header->id3), 1, fp)) return RET_ERROR;
-	if (1 != fwrite(header->version, sizeof(header->version), 1, fp)) return RET_ERROR;
-	if (1 != fwrite(&(header->flag), sizeof(header->flag), 1, fp)) return RET_ERROR;
-	if (1 != fwrite(&headersize, FOUR_BYTE, 1, fp)) return RET_ERROR;
+	batch->pool = create_pool(jobs, (size_t)jobs * BATCH_QUEUE_PER_WORKER, batch_worker, batch);
+	if (batch->pool == NULL) {
+		for (i = 0; i < jobs; i++) {
+			if (batch->worker[i].log != stdout) fclose(batch->worker[i].log);
+			free(batch->worker[i].logbuf);
+		}
+		free(batch->worker);
+		pthread_mutex_destroy(&batch->outlock);
+		return RET_ERROR;
+	}
 
-#ifdef DEBUG2_ON
-	printf("header->size = %08X : headersize = %08X\n", header->size, headersize);
-	printf("id3s = %d : vers = %d : flas = %d : sizs = %d\n", sizeof(header->id3), sizeof(header->version), sizeof(header->flag), sizeof(header->size));
-#endif
-	
 	return RET_OK;
 }
 
 
-/* write_id3 extheader ******************
-   ߂lF0 G[1
-*****************************************/
-int write_id3_extheader(const ID3EXTHEADER *header, FILE *fp) {
-	unsigned int headersize;
-	unsigned int paddingsize;
-	
-	if (fp == NULL) return RET_ERROR;
-	
-	// gGfBArbOGfBAɖ߂
-	headersize = REVERSE_ENDIAN(header->size);
-	paddingsize = REVERSE_ENDIAN(header->padding_size);
+/* add_batch_file *****************************
+   t@C1Xbhv[ɐς
+   opt [--journal] őO̎spt@C͐ς܂Ȃ
+***********************************************/
+void add_batch_file(ID3BATCH *batch, const char *path) {
+	int ret;
+
+	if (batch->journal != NULL) {
+		ret = add_id3_journal(batch->journal, path);
+		if (ret == 0) return;
+		if (ret < 0) {
+			fprintf(stderr, "%s : journal write error\n", path);
+			__atomic_add_fetch(&batch->failed, 1, __ATOMIC_SEQ_CST);
+			return;
+		}
+	}
+	submit_batch_file(batch, path);
+}
+
 
-	if (1 != fwrite(&headersize, FOUR_BYTE, 1, fp)) return RET_ERROR;
-	if (1 != fwrite(header->flag, sizeof(header->flag), 1, fp)) return RET_ERROR;
-	if (1 != fwrite(&paddingsize, FOUR_BYTE, 1, fp)) return RET_ERROR;
+/* submit_batch_file **************************
+   t@C1L^ɃXbhv[ɐς
+***********************************************/
+void submit_batch_file(ID3BATCH *batch, const char *path) {
+	char *item;
 
-	if (header->flag[0] & EXT_FLAG_CRC) {
-		if (1 != fwrite(header->crc, sizeof(header->crc), 1, fp)) return RET_ERROR;
+	if (batch->uring != NULL) {
+		add_uring_batch(batch->uring, path);
+		return;
 	}
 
-	return RET_OK;
+	item = strdup(path);
+	if ((item == NULL) || submit_pool(batch->pool, item)) {
+		fprintf(stderr, "%s : repair failed\n", path);
+		free(item);
+		__atomic_add_fetch(&batch->failed, 1, __ATOMIC_SEQ_CST);
+		return;
+	}
 }
 
 
-/* write_id3 frame *****************************
-   ߂lF0 G[1
-************************************************/
-int write_id3_frame(const ID3FRAMEHEADER *header, FILE *fpr, FILE *fpw) {
-	unsigned int headersize;
+/* check_batch_name ***************************
+   fBNgTŏΏۂƂt@CmF
 
-	if ((fpr == NULL) || (fpw == NULL)) return RET_ERROR;
+   ߂lFΏ1 ΏۊO0
+***********************************************/
+int check_batch_name(const char *name) {
+	size_t len = strlen(name);
+	size_t extlen = strlen(BATCH_FILE_EXT);
 
-	// gGfBArbOGfBAɖ߂
-	headersize = REVERSE_ENDIAN(header->size);
+	if (len <= extlen) return 0;
+	return (0 == strcasecmp(name + len - extlen, BATCH_FILE_EXT));
+}
 
-	if (1 != fwrite(header->id, sizeof(header->id), 1, fpw)) return RET_ERROR;
-	if (1 != fwrite(&headersize, FOUR_BYTE, 1, fpw)) return RET_ERROR;
-	if (1 != fwrite(&(header->flag), sizeof(header->flag), 1, fpw)) return RET_ERROR;
 
-	// framẽf[^Rs[
-	if (fncopy(fpw, fpr, header->size)) return RET_ERROR;
-	
-	return RET_OK;
-}
+/* add_batch_path *****************************
+   pathfBNgł΍ċAIɒTA
+   *.mp3t@CSĐς
+   t@Cł΂̂܂ܐς
 
+   top: R}hCŎw肳ꂽpathł1
+   ߂lF0 G[-1
+***********************************************/
+int add_batch_path(ID3BATCH *batch, const char *path, int top) {
+	struct stat st;
+	DIR *dir;
+	struct dirent *ent;
+	char *child;
+	size_t len;
+	int ret = RET_OK;
+
+	// R}hC̎w̓NāAT̓NHȂ
+	if ((top ? stat(path, &st) : lstat(path, &st)) != 0) {
+		fprintf(stderr, "file open error : %s\n", path);
+		__atomic_add_fetch(&batch->failed, 1, __ATOMIC_SEQ_CST);
+		return RET_ERROR;
+	}
 
-/* write_id3 repair_apic_frame **********
-   ߂lF0 G[1
-*****************************************/
-int write_id3_repair_apic_frame(const ID3FRAMEHEADER *header, FILE *fpr, FILE *fpw) {
-	unsigned int headersize;
-	unsigned char buf;
+	if (S_ISREG(st.st_mode)) {
+		if (top || check_batch_name(path)) add_batch_file(batch, path);
+		return RET_OK;
+	}
+	if (!S_ISDIR(st.st_mode)) return RET_OK;
 
-	if ((fpr == NULL) || (fpw == NULL)) return RET_ERROR;
+	dir = opendir(path);
+	if (dir == NULL) {
+		fprintf(stderr, "directory open error : %s\n", path);
+		__atomic_add_fetch(&batch->failed, 1, __ATOMIC_SEQ_CST);
+		return RET_ERROR;
+	}
+	len = strlen(path);
+	while ((ent = readdir(dir)) != NULL) {
+		if ((0 == strcmp(ent->d_name, ".")) || (0 == strcmp(ent->d_name, ".."))) continue;
+		// t@CłΖOŔ肵statȂ
+		if ((ent->d_type == DT_REG) && !check_batch_name(ent->d_name)) continue;
+		if ((ent->d_type != DT_REG) && (ent->d_type != DT_DIR) && (ent->d_type != DT_UNKNOWN)) continue;
+
+		child = malloc(len + 1 + strlen(ent->d_name) + 1);
+		if (child == NULL) {
+			ret = RET_ERROR;
+			break;
+		}
+		sprintf(child, "%s%s%s", path, (len > 0 && path[len-1] == '/') ? "" : "/", ent->d_name);
+		if (ent->d_type == DT_REG) add_batch_file(batch, child);
+		else if (add_batch_path(batch, child, 0)) ret = RET_ERROR;
+		free(child);
+	}
+	closedir(dir);
 
-	headersize = header->size -1;
-	headersize = REVERSE_ENDIAN(headersize);	// gGfBArbOGfBAɖ߂
+	return ret;
+}
 
-	if (1 != fwrite(header->id, sizeof(header->id), 1, fpw)) return RET_ERROR;
-	if (1 != fwrite(&headersize, FOUR_BYTE, 1, fpw)) return RET_ERROR;
-	if (1 != fwrite(&(header->flag), sizeof(header->flag), 1, fpw)) return RET_ERROR;
 
-	//  encode"ima"܂ŃRs[
-	if (fncopy(fpw, fpr, 4)) return RET_ERROR;
+/* add_batch_list *****************************
+   NUL؂̃t@CꗗǂݍŐς
 
-	// S~`FbN
-	if (1 != fread(&buf, 1, 1, fpr)) return RET_ERROR;
-	if (buf != 0) {
-		fprintf(stderr, "not [ima ge]. char is %c (%02X).\n", buf, buf);
+   listname: ꗗt@C ("-"ȂW)
+   ߂lF0 G[-1
+***********************************************/
+int add_batch_list(ID3BATCH *batch, const char *listname) {
+	FILE *fp;
+	char *line = NULL;
+	size_t n = 0;
+	ssize_t len;
+
+	fp = (0 == strcmp(listname, "-")) ? stdin : fopen(listname, "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "file open error : %s\n", listname);
+		__atomic_add_fetch(&batch->failed, 1, __ATOMIC_SEQ_CST);
 		return RET_ERROR;
 	}
 
-	// cf[^Rs[(Rs[ꂽ4byteƃS~̕sizej
-	if (fncopy(fpw, fpr, (header->size -4 -1))) return RET_ERROR;
+	while ((len = getdelim(&line, &n, '\0', fp)) > 0) {
+		if (line[len-1] == '\0') len--;
+		if (len == 0) continue;
+		line[len] = '\0';
+		add_batch_path(batch, line, 1);
+	}
+	free(line);
+	if (fp != stdin) fclose(fp);
 
 	return RET_OK;
 }
 
 
-/* seek id3_next_frame ******************
-   ߂lF0 G[1
-*****************************************/
-int seek_id3_next_frame(FILE *fp, const ID3FRAMEHEADER *header) {
-	if (fp == NULL) return RET_ERROR;
-	if (fseek(fp, header->size, SEEK_CUR)) return RET_ERROR;
-	
-	return RET_OK;
-}
+/* watch_batch ********************************
+   opt [--watch DIR] sigmask̃VOi󂯂܂DIRȉĎA
+   ܂ꂽt@CCxg~łς
+   ҂WATCH_FILE_MAXɒBƁAv[ɋ󂫂ł܂
+   (submit_pool҂)Cxgǂ܂Ȃ
+   Cxg肱ڂꍇDIRŜT
 
-
-/* get_id3_apic_type ********************
-   apictypeapictypeZbg
    ߂lF0 G[-1
-*****************************************/
-int get_id3_apic_type(FILE *fp, unsigned char *apictype) {
-	ID3APICFRAME apicframe;
-	fpos_t pos;
-	int cnt = 0;
-
-	if (fp == NULL) return RET_ERROR;
-	if (fgetpos(fp, &pos)) return RET_ERROR;
-
-	if (0 >= fread(&(apicframe.encode), 1, 1, fp)) goto GET_ID3_APIC_TYPE_ERROR;
-	// S~ꏊ܂Őɓǂݍ
-	if (0 >= fread(apicframe.mimetype, 1, 4, fp)) goto GET_ID3_APIC_TYPE_ERROR;
-	cnt = 4;
-
-	// mimetypeǂݍ
-	while (0 < fread(&apicframe.mimetype[cnt], 1, 1, fp)) {
-		if (apicframe.mimetype[cnt] == 0) break;
-		if (cnt >= MIMETYPE_MAXSIZE) goto GET_ID3_APIC_TYPE_ERROR;
-		cnt++;
+***********************************************/
+int watch_batch(ID3BATCH *batch, const char *dir, const sigset_t *sigmask) {
+	ID3WATCH w;
+	struct pollfd pfd[2];
+	char *path;
+	int sfd, ret = RET_OK;
+
+	sfd = signalfd(-1, sigmask, SFD_CLOEXEC);
+	if (sfd < 0) return RET_ERROR;
+	if (open_id3_watch(&w, dir, WATCH_DELAY_MS, WATCH_FILE_MAX, check_batch_name)) {
+		close(sfd);
+		return RET_ERROR;
 	}
+	batch->flushlog = 1;
+	if (batch->option->flag & OPTFLAG_VERBOSE) fprintf(stderr, "watching %s (%zu directories)\n", dir, w.dirnum);
 
-	// typeǂݍ
-	if (0 >= fread(apictype, 1, 1, fp)) goto GET_ID3_APIC_TYPE_ERROR;	
+	pfd[0].fd = w.fd;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = sfd;
+	pfd[1].events = POLLIN;
+	while (1) {
+		if ((poll(pfd, 2, get_id3_watch_timeout(&w)) < 0) && (errno != EINTR)) {
+			ret = RET_ERROR;
+			break;
+		}
+		if (pfd[1].revents & POLLIN) break;
 
-	if (*apictype >= PICTURE_TYPE_NUM) {
-		fprintf(stderr, "This APIC type (%02X) is undefined.\n", *apictype);
-		goto GET_ID3_APIC_TYPE_ERROR;
+		if (read_id3_watch(&w)) {
+			ret = RET_ERROR;
+			break;
+		}
+		if (w.overflow) {
+			fprintf(stderr, "watch queue overflow : %s is searched again\n", dir);
+			w.overflow = 0;
+			add_batch_path(batch, dir, 1);
+		}
+		while ((path = take_id3_watch(&w, 0)) != NULL) {
+			add_batch_file(batch, path);
+			free(path);
+		}
 	}
-	
-	if (fseek(fp, pos, SEEK_SET)) return RET_ERROR;
 
-#ifdef DEBUG2_ON
-	printf("pictype = %02X\n", *apictype);
-#endif
-	return RET_OK;
+	// ҂Ă͑҂ɐς
+	while ((path = take_id3_watch(&w, 1)) != NULL) {
+		add_batch_file(batch, path);
+		free(path);
+	}
+	close_id3_watch(&w);
+	close(sfd);
 
-  GET_ID3_APIC_TYPE_ERROR:
-	if (fseek(fp, pos, SEEK_SET)) return RET_ERROR;
-	return RET_ERROR;	
+	return ret;
 }
-	
-
-/* check_id3_mime_type ******************
-   mimetype  "ima ge"ƂȂĂȂ`FbN
-   fpos͏Ԃɖ߂
-
-   ߂lF0 C1 G[-1
-*****************************************/
-int check_id3_mime_type(FILE *fp) {
-	ID3APICFRAME apicframe;
-	fpos_t pos;
-	int cnt = 0;
 
-	if (fp == NULL) return RET_ERROR;
-	if (fgetpos(fp, &pos)) return RET_ERROR;
 
-	if (0 >= fread(&(apicframe.encode), 1, 1, fp)) goto CHECK_ID3_MIME_TYPE_ERROR;
-	if (0 >= fread(apicframe.mimetype, 1, 4, fp)) goto CHECK_ID3_MIME_TYPE_ERROR;
+/* close_batch ********************************
+   ς񂾎dSďÎ҂Ac̏o͂o
 
-	cnt = 4;
+   ߂lFSĐ0 s-1
+           --checkŏCKvȃt@C1
+***********************************************/
+int close_batch(ID3BATCH *batch) {
+	int i;
 
-	// S~`FbN
-	if (apicframe.mimetype[cnt-1] == 0) {
-		if (fseek(fp, pos, SEEK_SET)) return RET_ERROR;
-		return RET_FAILURE;
+	if (batch->uring != NULL) {
+		close_uring_batch(batch->uring);
+		free(batch->uring);
+		goto CLOSE_BATCH_EXIT;
 	}
 
-	// mimetypeǂݍ
-	while (0 < fread(&apicframe.mimetype[cnt], 1, 1, fp)) {
-		if (apicframe.mimetype[cnt] == 0) break;
-		if (cnt >= MIMETYPE_MAXSIZE) goto CHECK_ID3_MIME_TYPE_ERROR;
-		cnt++;
-	}
+	finish_pool(batch->pool);
 
-	if (fseek(fp, pos, SEEK_SET)) return RET_ERROR;
-#ifdef DEBUG_ON
-	printf("mimetype = %s\n", apicframe.mimetype);
-#endif
-	return RET_OK;
+	for (i = 0; i < batch->num; i++) {
+		flush_batch_log(batch, &(batch->worker[i]));
+		if (batch->worker[i].log != stdout) fclose(batch->worker[i].log);
+		free(batch->worker[i].logbuf);
+		add_id3_stats(&(batch->stats), &(batch->worker[i].stats));
+	}
+	free(batch->worker);
+	pthread_mutex_destroy(&batch->outlock);
 
-  CHECK_ID3_MIME_TYPE_ERROR:
-	if (fseek(fp, pos, SEEK_SET)) return RET_ERROR;
-	return RET_ERROR;	
+  CLOSE_BATCH_EXIT:
+	if (batch->option->stats != STATS_OFF) print_id3_stats(stdout, NULL, &(batch->stats), batch->option->stats);
+	if (batch->failed > 0) return RET_ERROR;
+	return (batch->repair > 0) ? RET_FAILURE : RET_OK;
 }
 
 
-/* check_id3_tag *******************************
-   ID3V2.3`̃t@Cł邩mF
-
-   ߂lFID3V2.3,1  Not,0
-************************************************/
-int check_id3_tag(const ID3HEADER *header) {
-	if (0 != strncmp(header->id3, ID3_HEADER_ID_CHECK, ID3_HEADER_ID_SIZE)) return 0;
-	if (header->version[0] != ID3_HEADER_VERSION_CHECK) return 0;
-	
-	return 1;
-}
-
+/* open_uring_batch ***************************
+   io_uringGWpӂ
 
-/* get_id3_repair_size ******************
-   CKvȂ 0 Ԃ
+   ߂lF0 io_uringΉȂ-1
+***********************************************/
+int open_uring_batch(ID3URINGBATCH *e, const ID3OPTION *option, int *failed, int *repair, ID3STATS *total, ID3CACHE *cache, ID3JOURNAL *journal) {
+	int i;
 
-   ߂lFC\z^OTCY
-*****************************************/
-unsigned int get_id3_repair_size(FILE *fp) {
-	ID3HEADER header;
-	ID3EXTHEADER extheader;
-	ID3FRAMEHEADER frameheader;
-	unsigned char apictypeflag[PICTURE_TYPE_NUM];  // pictypeo邽߂ɃtO𗧂Ă
-	unsigned char apictype;
-	unsigned int repairsize = 0;
-	fpos_t pos;
-	unsigned int ret;
+	memset(e, 0, sizeof(*e));
+	if (init_uring(&(e->ring), URING_ENTRIES)) return RET_ERROR;
 
-	memset(&extheader, 0, sizeof(extheader));
-	memset(apictypeflag, 0, PICTURE_TYPE_NUM);
-	
-	// wb_ǂݍ
-	if (read_id3_header(&header, fp)) return RET_ERROR;
-	if (! check_id3_tag(&header)) {
-		fprintf(stderr, "It doesn't correspond to this file format. Please let me read the file of the ID3v2.3 form. \n");
+	// READ/WRITELinux 5.6ȍ~ (5.1`5.5łsetupłĂS-EINVALɂȂ)
+	if ((1 != probe_uring_op(&(e->ring), IORING_OP_READ)) || (1 != probe_uring_op(&(e->ring), IORING_OP_WRITE))
+		|| (1 != probe_uring_op(&(e->ring), IORING_OP_FSYNC))) {
+		exit_uring(&(e->ring));
 		return RET_ERROR;
 	}
-	repairsize = header.size;
 
-	// gwb_ǂݍ
-	if (header.flag & FLAG_EXT) {
-		if (read_id3_extheader(&extheader, fp)) return RET_ERROR;
-		if (extheader.flag[0] & EXT_FLAG_CRC) {
-			fprintf(stderr, "It doesn't correspond to CRC.\n");
-			return RET_ERROR;
-		}
+	e->option = option;
+	e->failed = failed;
+	e->repair = repair;
+	e->total = total;
+	e->cache = cache;
+	e->journal = journal;
+	e->renameat = (1 == probe_uring_op(&(e->ring), IORING_OP_RENAMEAT));
+	for (i = 0; i < URING_SLOT_NUM; i++) {
+		e->slot[i].fdr = -1;
+		e->slot[i].fdw = -1;
 	}
 
-	// t[ǂݍ
-	do {
-#ifdef DEBUG_ON
-		printf("repairsize = %08X\n", repairsize);
-#endif
-		if (read_id3_frame_header(&frameheader, fp)) return RET_ERROR;
+	return RET_OK;
+}
 
-		if (frameheader.id[0] == 0) break; // padding̈N
 
-		// 폜Ώ̃t[^Cv`FbN
-		if (g_flag & OPTFLAG_DELETE) {
-			if (0 == strncmp(frameheader.id, g_del_frametype, ID3_FRAME_ID_SIZE)) {
-				repairsize -= ID3_FRAME_SIZE + frameheader.size;
-				if (seek_id3_next_frame(fp, &frameheader)) return RET_ERROR;
-				fgetpos(fp, &pos);
-#ifdef DEBUG_ON
-		printf("delete %c%c%c%c frame\n", frameheader.id[0], frameheader.id[1], frameheader.id[2], frameheader.id[3]);
-#endif
-				continue;
-			}
+/* add_uring_batch ****************************
+   t@C1̏Jn
+   󂫃XbgȂΊ҂
+***********************************************/
+void add_uring_batch(ID3URINGBATCH *e, const char *path) {
+	ID3SLOT *slot = NULL;
+	struct io_uring_sqe *sqe;
+	int i, ret;
+
+	while (e->active >= URING_SLOT_NUM) run_uring_batch(e, 1);
+	for (i = 0; i < URING_SLOT_NUM; i++) {
+		if (e->slot[i].state == SLOT_FREE) {
+			slot = &(e->slot[i]);
+			break;
 		}
+	}
 
-		// APIC̏ꍇɂ͏dMIMETYPE`FbN
-		if (0 == strncmp(frameheader.id, ID3_FRAME_ID_PIC, ID3_FRAME_ID_SIZE)) {
-			if (g_flag & OPTFLAG_REPETITION) {
-				if (get_id3_apic_type(fp, &apictype)) return RET_ERROR;
-				if (apictypeflag[apictype]) {
-					repairsize -= ID3_FRAME_SIZE + frameheader.size;
-					if (seek_id3_next_frame(fp, &frameheader)) return RET_ERROR;
-					fgetpos(fp, &pos);
-#ifdef DEBUG_ON
-					printf("delete repetition APIC\n");
-#endif
-					continue;
-				}
-				apictypeflag[apictype] = 1;
-			}
+	memset(&(slot->job), 0, sizeof(slot->job));
+	slot->job.option = e->option;
+	slot->job.log = stdout;
+	slot->job.cache = e->cache;
+	slot->job.journal = e->journal;
+	strncpy(slot->job.filename, path, FILENAME_MAX - 1);
+	slot->headersize = RET_ERROR; //  (finish_uring_slotŋL^Ȃ)
+	slot->taghash = 0;
+	e->active++;
+
+	// ̃t@CƏdȂ̂ŁAԂ̓t@ČoߎԂɂȂ
+	if (e->option->stats != STATS_OFF) {
+		memset(&(slot->stats), 0, sizeof(slot->stats));
+		slot->stats.files = 1;
+		slot->job.stats = &(slot->stats);
+		start_id3_stats(slot->job.stats, STATS_TOTAL);
+	}
 
-			ret = check_id3_mime_type(fp);
-			if (ret == 1) repairsize--;
-			else if (ret != 0) return RET_ERROR;
-		}
+	// O񂩂ςĂȂΊJɏI
+	if (skip_id3_cache(&(slot->job), 0, &ret)) {
+		finish_uring_slot(e, slot, ret);
+		return;
+	}
 
-		if (seek_id3_next_frame(fp, &frameheader)) return RET_ERROR;
-		fgetpos(fp, &pos);
-#ifdef DEBUG_ON
-		printf("endsize = %08X\n", (header.size - extheader.padding_size + ID3_HEADER_SIZE));
-		printf("pos = %08X\n", (unsigned int)pos);
-#endif
-	} while (header.size - extheader.padding_size + ID3_HEADER_SIZE >= pos); // padding̈悩DATÄɗ܂Ńt[ǂ
+	// ^O̐ǂ
+	slot->fdr = open(path, O_RDONLY);
+	if (slot->fdr < 0) {
+		fprintf(stderr, "file open error : %s\n", path);
+		finish_uring_slot(e, slot, RET_ERROR);
+		return;
+	}
+	slot->buf = malloc(TAG_READ_SIZE);
+	sqe = get_uring_sqe(&(e->ring));
+	if ((slot->buf == NULL) || (sqe == NULL)) {
+		finish_uring_slot(e, slot, RET_ERROR);
+		return;
+	}
+	slot->buflen = 0;
+	slot->bufsize = TAG_READ_SIZE;
+	prep_uring_rw(sqe, IORING_OP_READ, slot->fdr, slot->buf, TAG_READ_SIZE, 0, slot - e->slot);
+	slot->state = SLOT_READ_TAG;
 
-	if (repairsize == header.size) repairsize = 0;
-	
-	return repairsize;
+	// SQ܂܂Ƃ߂submit
+	if (e->ring.sq_pending >= URING_SUBMIT_BATCH) run_uring_batch(e, 0);
 }
 
 
-/* repair_id3_tag *****************************
-   id3^OC
+/* run_uring_batch ****************************
+   ς݂̏submitÂi߂
 
-   ߂lF(F0@sF-1)
-   ӁFOget_id3_repair_sizes
-         headersize擾ĂKv
+   wait: 1ȂŒ1̊҂
 ***********************************************/
-int repair_id3_tag(FILE *fpw, FILE *fpr, unsigned int headersize) {
-	ID3HEADER header;
-	ID3EXTHEADER extheader;
-	ID3FRAMEHEADER frameheader;
-	unsigned char apictypeflag[PICTURE_TYPE_NUM];  // pictypeo邽߂ɃtO𗧂Ă
-	unsigned char apictype;
-	fpos_t pos;
-	unsigned int ret, oldheadersize;
-
-	memset(&extheader, 0, sizeof(extheader));
-	memset(apictypeflag, 0, PICTURE_TYPE_NUM);
-	
-	// wb_
-	if (read_id3_header(&header, fpr)) return RET_ERROR;
-	oldheadersize = header.size;
-	header.size = headersize; 	// wb_TCYC̒lɕύX
-	if (write_id3_header(&header, fpw)) return RET_ERROR;
-	
-
-	// gwb_
-	if (header.flag & FLAG_EXT) {
-		if (read_id3_extheader(&extheader, fpr)) return RET_ERROR;
-		if (extheader.flag[0] & EXT_FLAG_CRC) {
-			fprintf(stderr, "It doesn't correspond to CRC.\n");
-			return RET_ERROR;
+void run_uring_batch(ID3URINGBATCH *e, int wait) {
+	struct io_uring_cqe *cqe;
+	ID3SLOT *slot;
+	int res;
+
+	if (submit_uring(&(e->ring), wait) < 0) {
+		// submitłȂΑSĎsƂ
+		fprintf(stderr, "io_uring submit error\n");
+		for (res = 0; res < URING_SLOT_NUM; res++) {
+			if (e->slot[res].state != SLOT_FREE) finish_uring_slot(e, &(e->slot[res]), RET_ERROR);
 		}
-		if (write_id3_extheader(&extheader, fpw)) return RET_ERROR;
+		return;
 	}
 
-	// t[
-	do {
-		if (read_id3_frame_header(&frameheader, fpr)) return RET_ERROR;
+	while ((cqe = peek_uring_cqe(&(e->ring))) != NULL) {
+		slot = &(e->slot[cqe->user_data]);
+		res = cqe->res;
+		seen_uring_cqe(&(e->ring));
+		step_uring_slot(e, slot, res);
+	}
+}
 
-		// padding̈N
-		if (frameheader.id[0] == 0) {
-			if (ID3_FRAME_SIZE != fwrite(&(frameheader.id[0]), 1, ID3_FRAME_SIZE, fpw)) return RET_ERROR;
-			break;
+
+/* step_uring_slot ****************************
+   ̌ʂ玟̏
+   t[̏repair_id3_fileƓ֐g
+***********************************************/
+void step_uring_slot(ID3URINGBATCH *e, ID3SLOT *slot, int res) {
+	const ID3OPTION *option = e->option;
+	struct io_uring_sqe *sqe;
+	unsigned long long id = slot - e->slot;
+	unsigned int tagsize;
+	size_t len;
+	unsigned char *p;
+	struct stat st;
+	FILE *fp;
+
+	// read/write𐔂
+	if ((slot->job.stats != NULL) && (res > 0)) {
+		if ((slot->state == SLOT_READ_TAG) || (slot->state == SLOT_READ_DATA)) {
+			slot->stats.reads++;
+			slot->stats.readbytes += res;
+		}
+		else if ((slot->state == SLOT_WRITE_TAG) || (slot->state == SLOT_WRITE_DATA)) {
+			slot->stats.writes++;
+			slot->stats.writebytes += res;
 		}
+	}
 
-		// 폜Ώ̃t[^Cv`FbN
-		if (g_flag & OPTFLAG_DELETE) {
-			if (0 == strncmp(frameheader.id, g_del_frametype, ID3_FRAME_ID_SIZE)) {
-				// 폜o
-				if (g_flag & OPTFLAG_VERBOSE) {
-					fgetpos(fpr, &pos);
-					printf("%s : delete frame (%s) %08X - %08X\n",
-						   g_filename, g_del_frametype, (unsigned int)pos-10, (unsigned int)pos+frameheader.size);
+	switch (slot->state) {
+	case SLOT_READ_TAG:
+		if (res < 0) goto STEP_URING_SLOT_ERROR;
+		slot->buflen += res;
+
+		// ǂ݂Ɏ܂Ȃ^O̎cǂ
+		if ((res > 0) && (slot->buflen >= ID3_HEADER_SIZE)
+			&& (0 == memcmp(slot->buf, ID3_HEADER_ID_CHECK, ID3_HEADER_ID_SIZE))) {
+			memcpy(&tagsize, slot->buf + 6, FOUR_BYTE);
+			tagsize = ID3_HEADER_SIZE + FROM_SYNCHSAFE(tagsize);
+			if (tagsize > slot->buflen) {
+				if (tagsize > slot->bufsize) {
+					p = realloc(slot->buf, tagsize);
+					if (p == NULL) goto STEP_URING_SLOT_ERROR;
+					slot->buf = p;
+					slot->bufsize = tagsize;
 				}
-				if (seek_id3_next_frame(fpr, &frameheader)) return RET_ERROR;
-				fgetpos(fpr, &pos);
-				continue;
+				sqe = get_uring_sqe(&(e->ring));
+				if (sqe == NULL) goto STEP_URING_SLOT_ERROR;
+				prep_uring_rw(sqe, IORING_OP_READ, slot->fdr, slot->buf + slot->buflen,
+							  tagsize - slot->buflen, slot->buflen, id);
+				return;
 			}
 		}
 
-		// APIC̏ꍇɂ͏dMIMETYPE`FbN
-		if (0 == strncmp(frameheader.id, ID3_FRAME_ID_PIC, ID3_FRAME_ID_SIZE)) {
-			if (g_flag & OPTFLAG_REPETITION) {
-				if (get_id3_apic_type(fpr, &apictype)) return RET_ERROR;
-				if (apictypeflag[apictype]) {
-					// 폜o
-					if (g_flag & OPTFLAG_VERBOSE) {
-						fgetpos(fpr, &pos);
-						printf("%s : delete frame (%s) %08X - %08X\n",
-							   g_filename, ID3_FRAME_ID_PIC, (unsigned int)pos-10, (unsigned int)pos+frameheader.size);
-					}
-					if (seek_id3_next_frame(fpr, &frameheader)) return RET_ERROR;
-					fgetpos(fpr, &pos);
-					continue;
-				}
-				apictypeflag[apictype] = 1;
+		// ^O͂
+		open_id3_reader_buf(&(slot->tag.reader), slot->buf, slot->buflen);
+		slot->buf = NULL;
+		start_id3_stats(slot->job.stats, STATS_PARSE);
+		res = parse_id3_tag(&(slot->tag));
+		stop_id3_stats(slot->job.stats, STATS_PARSE);
+		if (res) goto STEP_URING_SLOT_ERROR;
+		slot->tag.stats = slot->job.stats;
+		if (slot->job.cache != NULL) {
+			slot->taghash = hash_id3_data(slot->tag.reader.base, slot->tag.tagsize, 0);
+			if (skip_id3_cache(&(slot->job), slot->taghash, &res)) {
+				finish_uring_slot(e, slot, res);
+				return;
+			}
+		}
+		slot->headersize = get_id3_repair_size(&(slot->tag), option);
+		if ((option->flag & OPTFLAG_CHECK) && (RET_ERROR != slot->headersize)) {
+			print_id3_check(&(slot->job), (0 == slot->headersize) ? CHECK_CLEAN : CHECK_REPAIR, &(slot->tag.report));
+			finish_uring_slot(e, slot, (0 == slot->headersize) ? RET_OK : RET_FAILURE);
+			return;
+		}
+		if (0 == slot->headersize) {
+			finish_uring_slot(e, slot, RET_OK);
+			return;
+		}
+		if (RET_ERROR == slot->headersize) goto STEP_URING_SLOT_ERROR;
+
+		// C̃^Öɍ
+		fp = open_memstream((char **)&(slot->buf), &len);
+		if (fp == NULL) goto STEP_URING_SLOT_ERROR;
+		start_id3_stats(slot->job.stats, STATS_TAG);
+		res = (option->flag & OPTFLAG_INPLACE)
+			? write_id3_tag_inplace(fp, &(slot->tag), slot->headersize, &(slot->job))
+			: write_id3_tag(fp, &(slot->tag), slot->headersize, &(slot->job));
+		stop_id3_stats(slot->job.stats, STATS_TAG);
+		if (fclose(fp) || res) goto STEP_URING_SLOT_ERROR;
+		slot->buflen = len;
+
+		// ^Ö悾㏑
+		// (--journal̋L^fsync܂ő҂̂ŁA͓ď)
+		if (option->flag & OPTFLAG_INPLACE) {
+			if (slot->buflen != slot->tag.tagsize) {
+				fprintf(stderr, "in-place repair overran the tag region.\n");
+				goto STEP_URING_SLOT_ERROR;
+			}
+			if (journal_id3_file(&(slot->job), slot->fdr, JOURNAL_INPLACE, &(slot->tag))) goto STEP_URING_SLOT_ERROR;
+			close(slot->fdr);
+			slot->fdr = -1;
+			slot->fdw = open(slot->job.filename, O_WRONLY);
+			if (slot->fdw < 0) {
+				fprintf(stderr, "file open error : %s\n", slot->job.filename);
+				goto STEP_URING_SLOT_ERROR;
 			}
+			slot->done = 0;
+			slot->state = SLOT_WRITE_TAG;
+			goto STEP_URING_SLOT_WRITE_TAG;
+		}
 
-			ret = check_id3_mime_type(fpr);
-			if (ret == 1) {
-				// 폜o
-				if (g_flag & OPTFLAG_VERBOSE) {
-					fgetpos(fpr, &pos);
-					printf("%s : repair APIC frame (ima ge->image) %08X - %08X\n",
-						   g_filename, (unsigned int)pos-10, (unsigned int)pos+frameheader.size);
-				}
-				if (write_id3_repair_apic_frame(&frameheader, fpr, fpw)) return RET_ERROR;
-				fgetpos(fpr, &pos);
-				continue;
+		if (fstat(slot->fdr, &st)) goto STEP_URING_SLOT_ERROR;
+		slot->end = st.st_size;
+		if (FILENAME_MAX <= snprintf(slot->bak, FILENAME_MAX, "%s.bak", slot->job.filename)) goto STEP_URING_SLOT_ERROR;
+		if (journal_id3_file(&(slot->job), slot->fdr, JOURNAL_BACKUP, &(slot->tag))) goto STEP_URING_SLOT_ERROR;
+
+		// $1.bakreflinkō쐬ł.bakǂ݁At@C
+		start_id3_stats(slot->job.stats, STATS_BACKUP);
+		res = clone_id3_backup(slot->fdr, slot->bak);
+		stop_id3_stats(slot->job.stats, STATS_BACKUP);
+		if (RET_OK == res) {
+			close(slot->fdr);
+			slot->fdr = open(slot->bak, O_RDONLY);
+			if (slot->fdr < 0) {
+				fprintf(stderr, "file open error : %s\n", slot->bak);
+				goto STEP_URING_SLOT_ERROR;
+			}
+			slot->fdw = open(slot->job.filename, O_WRONLY);
+			if (slot->fdw < 0) {
+				fprintf(stderr, "file open error : %s\n", slot->job.filename);
+				goto STEP_URING_SLOT_ERROR;
 			}
-			else if (ret != 0) return RET_ERROR;
+			print_id3_backup(&(slot->job), slot->bak, BACKUP_REFLINK);
+			slot->done = 0;
+			slot->state = SLOT_WRITE_TAG;
+			goto STEP_URING_SLOT_WRITE_TAG;
 		}
 
-		if (write_id3_frame(&frameheader, fpr, fpw)) return RET_ERROR;
-		fgetpos(fpr, &pos);
-#ifdef DEBUG2_ON
-		printf("endsize = %08X\n", (oldheadersize - extheader.padding_size + ID3_HEADER_SIZE));
-		printf("pos = %08X\n", (unsigned int)pos);
-#endif		
-	} while (oldheadersize - extheader.padding_size + ID3_HEADER_SIZE >= pos); // padding̈悩DATÄɗ܂Ńt[ǂ
+		// filenamẽt@C$1.bakɖOύX (ǂݍ݂fdr̂܂ܑ)
+		slot->state = SLOT_RENAME;
+		if (e->renameat) {
+			sqe = get_uring_sqe(&(e->ring));
+			if (sqe == NULL) goto STEP_URING_SLOT_ERROR;
+			prep_uring_rename(sqe, slot->job.filename, slot->bak, id);
+			return;
+		}
+		res = rename(slot->job.filename, slot->bak) ? -errno : 0;
+		/* FALLTHROUGH */
+
+	case SLOT_RENAME:
+		// IORING_OP_RENAMEATΉ̃J[lłΈȍ~renameg
+		if ((res == -EINVAL) && e->renameat) {
+			e->renameat = 0;
+			res = rename(slot->job.filename, slot->bak) ? -errno : 0;
+		}
+		if (res < 0) goto STEP_URING_SLOT_ERROR;
+		print_id3_backup(&(slot->job), slot->bak, BACKUP_RENAME);
 
-	// pfBÖAf[^̈Rs[
-	fcopy(fpw, fpr);
-	
-	return RET_OK;
+		slot->fdw = open(slot->job.filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if (slot->fdw < 0) {
+			fprintf(stderr, "file open error : %s\n", slot->job.filename);
+			goto STEP_URING_SLOT_ERROR;
+		}
+		slot->done = 0;
+		slot->state = SLOT_WRITE_TAG;
+		goto STEP_URING_SLOT_WRITE_TAG;
+
+	case SLOT_WRITE_TAG:
+		if (res <= 0) goto STEP_URING_SLOT_ERROR;
+		slot->done += res;
+
+	  STEP_URING_SLOT_WRITE_TAG:
+		if (slot->done < slot->buflen) {
+			sqe = get_uring_sqe(&(e->ring));
+			if (sqe == NULL) goto STEP_URING_SLOT_ERROR;
+			prep_uring_rw(sqe, IORING_OP_WRITE, slot->fdw, slot->buf + slot->done,
+						  slot->buflen - slot->done, slot->done, id);
+			return;
+		}
+
+		if (option->flag & OPTFLAG_INPLACE) {
+			sqe = get_uring_sqe(&(e->ring));
+			if (sqe == NULL) goto STEP_URING_SLOT_ERROR;
+			prep_uring_fsync(sqe, slot->fdw, id);
+			slot->state = SLOT_FSYNC;
+			return;
+		}
+
+		// f[^̈̃Rs[ (ǂݍ݂Ə݂݂ɍs)
+		free(slot->buf);
+		slot->buf = malloc(URING_COPY_SIZE);
+		if (slot->buf == NULL) goto STEP_URING_SLOT_ERROR;
+		slot->in = slot->tag.tagsize;
+		slot->out = slot->buflen;
+		goto STEP_URING_SLOT_READ_DATA;
+
+	case SLOT_READ_DATA:
+		if (res < 0) goto STEP_URING_SLOT_ERROR;
+		if (res == 0) {
+			// rŃt@Ck
+			if (ftruncate(slot->fdw, slot->out)) goto STEP_URING_SLOT_ERROR;
+			goto STEP_URING_SLOT_FSYNC;
+		}
+		slot->buflen = res;
+		slot->done = 0;
+		slot->state = SLOT_WRITE_DATA;
+		goto STEP_URING_SLOT_WRITE_DATA;
+
+	case SLOT_WRITE_DATA:
+		if (res <= 0) goto STEP_URING_SLOT_ERROR;
+		slot->done += res;
+
+	  STEP_URING_SLOT_WRITE_DATA:
+		if (slot->done < slot->buflen) {
+			sqe = get_uring_sqe(&(e->ring));
+			if (sqe == NULL) goto STEP_URING_SLOT_ERROR;
+			prep_uring_rw(sqe, IORING_OP_WRITE, slot->fdw, slot->buf + slot->done,
+						  slot->buflen - slot->done, slot->out + slot->done, id);
+			return;
+		}
+		slot->in += slot->buflen;
+		slot->out += slot->buflen;
+
+	  STEP_URING_SLOT_READ_DATA:
+		if (slot->in >= slot->end) {
+			// reflinkt@C͏k񂾕؂l߂
+			if (ftruncate(slot->fdw, slot->out)) goto STEP_URING_SLOT_ERROR;
+			goto STEP_URING_SLOT_FSYNC;
+		}
+		sqe = get_uring_sqe(&(e->ring));
+		if (sqe == NULL) goto STEP_URING_SLOT_ERROR;
+		len = (slot->end - slot->in > URING_COPY_SIZE) ? URING_COPY_SIZE : (size_t)(slot->end - slot->in);
+		prep_uring_rw(sqe, IORING_OP_READ, slot->fdr, slot->buf, len, slot->in, id);
+		slot->state = SLOT_READ_DATA;
+		return;
+
+	  STEP_URING_SLOT_FSYNC:
+		// opt [--journal] łENDL^Oɏ݂m肳
+		if (slot->job.journal == NULL) {
+			finish_uring_slot(e, slot, RET_OK);
+			return;
+		}
+		sqe = get_uring_sqe(&(e->ring));
+		if (sqe == NULL) goto STEP_URING_SLOT_ERROR;
+		prep_uring_fsync(sqe, slot->fdw, id);
+		slot->state = SLOT_FSYNC;
+		return;
+
+	case SLOT_FSYNC:
+		if (res < 0) goto STEP_URING_SLOT_ERROR;
+		if ((option->flag & OPTFLAG_INPLACE) || (slot->job.journal == NULL)) {
+			finish_uring_slot(e, slot, RET_OK);
+			return;
+		}
+
+		// .bakƐVt@C̃Ggm肳 (ǂݍݗpfd͎gI)
+		close(slot->fdr);
+		slot->fdr = open_id3_journal_dir(slot->job.filename);
+		if (slot->fdr < 0) goto STEP_URING_SLOT_ERROR;
+		sqe = get_uring_sqe(&(e->ring));
+		if (sqe == NULL) goto STEP_URING_SLOT_ERROR;
+		prep_uring_fsync(sqe, slot->fdr, id);
+		slot->state = SLOT_FSYNC_DIR;
+		return;
+
+	case SLOT_FSYNC_DIR:
+		finish_uring_slot(e, slot, (res < 0) ? RET_ERROR : RET_OK);
+		return;
+
+	default:
+		return;
+	}
+
+  STEP_URING_SLOT_ERROR:
+	finish_uring_slot(e, slot, RET_ERROR);
 }
 
+
+/* finish_uring_slot **************************
+   Xbg
+***********************************************/
+void finish_uring_slot(ID3URINGBATCH *e, ID3SLOT *slot, int ret) {
+	if (slot->fdr >= 0) close(slot->fdr);
+	if ((slot->fdw >= 0) && close(slot->fdw)) ret = RET_ERROR;
+	free(slot->buf);
+
+	// ͂ʂL^ (C̃^Ohash͕s)
+	if ((ret != RET_ERROR) && (slot->headersize != RET_ERROR)) {
+		if (e->option->flag & OPTFLAG_CHECK) save_id3_cache(&(slot->job), slot->taghash, slot->headersize, &(slot->tag.report));
+		else save_id3_cache(&(slot->job), (0 == slot->headersize) ? slot->taghash : 0, 0, NULL);
+	}
+	free_id3_tag(&(slot->tag));
+	if ((slot->job.journal != NULL) && end_id3_journal(slot->job.journal, slot->job.filename, ret)) {
+		fprintf(stderr, "%s : journal write error\n", slot->job.filename);
+	}
+
+	if (ret == RET_FAILURE) {
+		(*e->repair)++;
+	}
+	else if (ret) {
+		if (e->option->flag & OPTFLAG_CHECK) print_id3_check(&(slot->job), CHECK_ERROR, NULL);
+		fprintf(stderr, "%s : repair failed\n", slot->job.filename);
+		(*e->failed)++;
+	}
+	if (slot->job.stats != NULL) {
+		stop_id3_stats(slot->job.stats, STATS_TOTAL);
+		print_id3_stats(stdout, slot->job.filename, slot->job.stats, e->option->stats);
+		add_id3_stats(e->total, slot->job.stats);
+		slot->job.stats = NULL;
+	}
+
+	slot->fdr = -1;
+	slot->fdw = -1;
+	slot->buf = NULL;
+	slot->state = SLOT_FREE;
+	e->active--;
+}
+
+
+/* close_uring_batch **************************
+   ̃t@CSďÎ҂
+***********************************************/
+void close_uring_batch(ID3URINGBATCH *e) {
+	while (e->active > 0) run_uring_batch(e, 1);
+	exit_uring(&(e->ring));
+}
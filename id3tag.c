@@ -0,0 +1,1947 @@
+/*
+  F
+    ID3v2.3^O̓ǂݍ݁ÉEo (id3tag.h)
+    t@CPʂ̏(.bak쐬Aob`)id3_tag_repair.cōs
+    scan.c crc32.c stats.cƋlibid3repair.aɂȂAO[oȏԂ͎Ȃ
+    (scan.c crc32.ckernelÎ݁AɌ߂atomicŋL)
+
+  Ql :
+     http://www.takaaki.info/id3/ID3v2.3.0J.html
+
+  쐬ҁ@@Fgbm
+*/
+
+
+/****************************************************/
+/*                     include                      */
+/****************************************************/
+#define _GNU_SOURCE // copy_file_range
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h> // pread, pwrite
+#include <sys/types.h>
+#include <sys/sendfile.h> // sendfile
+#include <fcntl.h> // splice, fallocate
+#include <sys/stat.h>
+#include <sys/mman.h> // mmap
+#include <zlib.h> // uncompress, compress2
+#include "id3tag.h"
+#include "crc32.h"
+
+
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+#define STREAM_BUF_SIZE 8192
+#define BUFFER_NAME "(buffer)"             // repair_id3_bufferverboseo͂ł̖O
+
+#define COPY_ALL ((off_t)-1)          // EOF܂ŃRs[
+#define COPY_KERNEL_MIN (64 * 1024)    // ȏ̃Rs[fdmōs
+#define COPY_CHUNK_SIZE 0x40000000     // copy_file_range,sendfile,splice 1̍ő
+#define COPY_BUF_SIZE (1024 * 1024)    // փRs[pobt@
+#define COPY_BUF_ALIGN 4096
+
+#define FRAME_LIST_SIZE 32        // t[ꗗ̏mې
+#define FRAME_UNPACK_MAX ID3_TAG_MAXSIZE  // kt[WJőbyte
+
+
+
+/****************************************************/
+/*                    Process                       */
+/****************************************************/
+
+/* fd_copy ********************************************
+   fdrinʒufdwoutʒu n byte Rs[B
+   copy_file_range  sendfile  obt@Rs[̏Ɏ
+
+   n: COPY_ALLȂEOF܂ŃRs[
+   stats: NULLłȂseek񐔂𐔂
+   ߂lFG[-1
+   ӁFin,out̓Rs[i߂
+*******************************************************/
+static int fd_copy(int fdw, off_t *out, int fdr, off_t *in, off_t n, ID3STATS *stats) {
+	ssize_t ret;
+	size_t len, done;
+	char *buf;
+
+	// copy_file_range (J[lŃRs[AFSɂĂextentLɂȂ)
+	while (n != 0) {
+		len = ((n == COPY_ALL) || (n > COPY_CHUNK_SIZE)) ? COPY_CHUNK_SIZE : (size_t)n;
+		ret = copy_file_range(fdr, in, fdw, out, len, 0);
+		if (ret < 0) {
+			if (errno == EINTR) continue;
+			if ((errno == EXDEV) || (errno == ENOSYS) || (errno == EINVAL)
+				|| (errno == EOPNOTSUPP) || (errno == EBADF)) break;
+			return RET_ERROR;
+		}
+		if (ret == 0) return (n == COPY_ALL) ? RET_OK : RET_ERROR; // EOF
+		if (n != COPY_ALL) n -= ret;
+	}
+	if (n == 0) return RET_OK;
+
+	// sendfile (o͑̓t@Cʒuĝō킹Ă)
+	if (stats != NULL) stats->seeks++;
+	if (lseek(fdw, *out, SEEK_SET) < 0) return RET_ERROR;
+	while (n != 0) {
+		len = ((n == COPY_ALL) || (n > COPY_CHUNK_SIZE)) ? COPY_CHUNK_SIZE : (size_t)n;
+		ret = sendfile(fdw, fdr, in, len);
+		if (ret < 0) {
+			if (errno == EINTR) continue;
+			if ((errno == EINVAL) || (errno == ENOSYS)) break;
+			return RET_ERROR;
+		}
+		if (ret == 0) return (n == COPY_ALL) ? RET_OK : RET_ERROR;
+		*out += ret;
+		if (n != COPY_ALL) n -= ret;
+	}
+	if (n == 0) return RET_OK;
+
+	// ǂgȂ΃ACgobt@ŃRs[
+	if (posix_memalign((void **)&buf, COPY_BUF_ALIGN, COPY_BUF_SIZE)) return RET_ERROR;
+	while (n != 0) {
+		len = ((n == COPY_ALL) || (n > COPY_BUF_SIZE)) ? COPY_BUF_SIZE : (size_t)n;
+		ret = pread(fdr, buf, len, *in);
+		if (ret < 0) {
+			if (errno == EINTR) continue;
+			goto FD_COPY_ERROR;
+		}
+		if (ret == 0) {
+			if (n == COPY_ALL) break;
+			goto FD_COPY_ERROR;
+		}
+		len = ret;
+		for (done = 0; done < len; done += ret) {
+			ret = pwrite(fdw, buf + done, len - done, *out + done);
+			if (ret < 0) {
+				if (errno != EINTR) goto FD_COPY_ERROR;
+				ret = 0;
+			}
+		}
+		*in += len;
+		*out += len;
+		if (n != COPY_ALL) n -= len;
+	}
+	free(buf);
+	return RET_OK;
+
+  FD_COPY_ERROR:
+	free(buf);
+	return RET_ERROR;
+}
+
+
+/* pipe_copy ******************************************
+   fdř݈ʒuEOF܂łfdw݈̌ʒuփRs[B
+   ǂ炩pCvłspliceAǂt@Cł
+   fd_copyAǂgȂ΃obt@ŃRs[
+
+   stats: NULLłȂseek񐔂𐔂
+   ߂lFG[-1
+*******************************************************/
+static int pipe_copy(int fdw, int fdr, ID3STATS *stats) {
+	ssize_t ret, len, done;
+	off_t in, out;
+	char *buf;
+
+	// splice (pCvƂ̊Ԃ̓J[lŃy[W󂯓n)
+	while ((ret = splice(fdr, NULL, fdw, NULL, COPY_CHUNK_SIZE, SPLICE_F_MOVE | SPLICE_F_MORE)) != 0) {
+		if (ret > 0) continue;
+		if (errno == EINTR) continue;
+		if (errno == EINVAL) break; // pCv
+		return RET_ERROR;
+	}
+	if (ret == 0) return RET_OK;
+
+	// t@Cm (_CNg) łΌ݈ʒufd_copy
+	in = lseek(fdr, 0, SEEK_CUR);
+	out = lseek(fdw, 0, SEEK_CUR);
+	if ((in >= 0) && (out >= 0)) {
+		if (fd_copy(fdw, &out, fdr, &in, COPY_ALL, stats)) return RET_ERROR;
+		if (stats != NULL) stats->seeks += 2;
+		if ((lseek(fdr, in, SEEK_SET) < 0) || (lseek(fdw, out, SEEK_SET) < 0)) return RET_ERROR;
+		return RET_OK;
+	}
+
+	// \Pbg
+	buf = malloc(COPY_BUF_SIZE);
+	if (buf == NULL) return RET_ERROR;
+	while ((len = read(fdr, buf, COPY_BUF_SIZE)) != 0) {
+		if (len < 0) {
+			if (errno == EINTR) continue;
+			goto PIPE_COPY_ERROR;
+		}
+		for (done = 0; done < len; done += ret) {
+			ret = write(fdw, buf + done, len - done);
+			if (ret < 0) {
+				if (errno != EINTR) goto PIPE_COPY_ERROR;
+				ret = 0;
+			}
+		}
+	}
+	free(buf);
+	return RET_OK;
+
+  PIPE_COPY_ERROR:
+	free(buf);
+	return RET_ERROR;
+}
+
+
+/* stream_copy ****************************************
+   fpř݈ʒufpw݈̌ʒu n byte Rs[B
+   ȃRs[stdiô܂܁A傫ȃRs[fd_copyōs
+
+   n: COPY_ALLȂEOF܂ŃRs[
+   stats: NULLłȂseek񐔂𐔂
+   ߂lFG[-1
+*******************************************************/
+static int stream_copy(FILE *fpw, FILE *fpr, off_t n, ID3STATS *stats) {
+	char buf[STREAM_BUF_SIZE];
+	off_t in, out;
+	size_t len;
+
+	if ((n != COPY_ALL) && (n < COPY_KERNEL_MIN)) goto STREAM_COPY_STDIO;
+
+	// stdiõobt@foĂfdŒڃRs[
+	if (fflush(fpw)) return RET_ERROR;
+	in = ftello(fpr);
+	out = ftello(fpw);
+	if ((in < 0) || (out < 0)) goto STREAM_COPY_STDIO; // pCv
+	if (fd_copy(fileno(fpw), &out, fileno(fpr), &in, n, stats)) return RET_ERROR;
+
+	// stdiõt@CʒuRs[̈ʒuɍ킹
+	if (stats != NULL) stats->seeks += 2;
+	if (fseeko(fpr, in, SEEK_SET)) return RET_ERROR;
+	if (fseeko(fpw, out, SEEK_SET)) return RET_ERROR;
+	return RET_OK;
+
+  STREAM_COPY_STDIO:
+	while (n != 0) {
+		len = ((n == COPY_ALL) || (n > STREAM_BUF_SIZE)) ? STREAM_BUF_SIZE : (size_t)n;
+		len = fread(buf, sizeof(char), len, fpr);
+		if (len == 0) {
+			if ((n == COPY_ALL) && !ferror(fpr)) break;
+			return RET_ERROR;
+		}
+		if (len != fwrite(buf, sizeof(char), len, fpw)) return RET_ERROR;
+		if (n != COPY_ALL) n -= len;
+	}
+	return RET_OK;
+}
+
+
+/* fcopy **********************************************
+   fpr̒gfpwɃRs[B
+
+   stats: vȂNULL
+   ߂lFG[-1
+*******************************************************/
+int fcopy(FILE *fpw, FILE *fpr, ID3STATS *stats) {
+	if ((fpr == NULL) || (fpw == NULL)) return RET_ERROR;
+
+	return stream_copy(fpw, fpr, COPY_ALL, stats);
+}
+
+
+/* fncopy *********************************************
+   fpr̒g n byte fpwɃRs[B
+
+   stats: vȂNULL
+   ߂lFG[-1
+*******************************************************/
+int fncopy(FILE *fpw, FILE *fpr, off_t n, ID3STATS *stats) {
+	if ((fpr == NULL) || (fpw == NULL) || (n < 0)) return RET_ERROR;
+	if (n == 0) return RET_OK;
+
+	return stream_copy(fpw, fpr, n, stats);
+}
+
+
+/* fdcopy *********************************************
+   fdr̎c(EOF܂)fpwɃRs[B
+   fdr̓pCvł悭AseekɑO珇ɓǂ
+
+   stats: vȂNULL
+   ߂lFG[-1
+*******************************************************/
+int fdcopy(FILE *fpw, int fdr, ID3STATS *stats) {
+	if ((fpw == NULL) || (fdr < 0)) return RET_ERROR;
+	if (fflush(fpw)) return RET_ERROR;
+	return pipe_copy(fileno(fpw), fdr, stats);
+}
+
+
+/* open_id3_reader ****************************
+   fd̃t@C擪^Oǂݍreaderpӂ
+   READER_MMAPw肳΃t@CmmapA
+   łȂpreadŃobt@ɓǂݍ
+
+   ߂lF0 G[-1
+   ӁFgpclose_id3_readerŉ
+************************************************/
+int open_id3_reader(ID3READER *rd, int fd, int type) {
+	struct stat st;
+	size_t len;
+	ssize_t n;
+	void *map;
+
+	memset(rd, 0, sizeof(*rd));
+	rd->fd = fd;
+
+	// mmap (^O̍őTCY܂ł}bv)
+	if ((type == READER_MMAP) && (0 == fstat(fd, &st)) && S_ISREG(st.st_mode) && (st.st_size > 0)) {
+		len = ((unsigned long long)st.st_size > ID3_HEADER_SIZE + ID3_TAG_MAXSIZE)
+			? ID3_HEADER_SIZE + ID3_TAG_MAXSIZE : (size_t)st.st_size;
+		map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+		if (map != MAP_FAILED) {
+			madvise(map, len, MADV_SEQUENTIAL);
+			rd->type = READER_MMAP;
+			rd->base = map;
+			rd->size = len;
+			return RET_OK;
+		}
+	}
+
+	// pread (̃^O͍ŏ̓ǂݍ݂Ŏ܂邽߁Aǂ݃TCY܂Ƃ߂ēǂ)
+	rd->type = READER_BUF;
+	rd->buf = malloc(TAG_READ_SIZE);
+	if (rd->buf == NULL) return RET_ERROR;
+	n = pread(fd, rd->buf, TAG_READ_SIZE, 0);
+	if (n < 0) {
+		close_id3_reader(rd);
+		return RET_ERROR;
+	}
+	rd->base = rd->buf;
+	rd->size = n;
+
+	return RET_OK;
+}
+
+
+/* open_id3_reader_buf ************************
+   ǂݍݍς݂̃obt@readerpӂ
+
+   buf: malloc̈ (ȍ~reader)
+   ߂lF0
+************************************************/
+int open_id3_reader_buf(ID3READER *rd, unsigned char *buf, size_t size) {
+	memset(rd, 0, sizeof(*rd));
+	rd->type = READER_BUF;
+	rd->fd = -1;
+	rd->buf = buf;
+	rd->base = buf;
+	rd->size = size;
+
+	return RET_OK;
+}
+
+
+/* open_id3_reader_mem ******************
+   Ăяobuf̂܂܎QƂ
+   (close_id3_readerŉAsize͓ǂ߂Ȃ)
+
+   ߂lF(F0@sF-1)
+****************************************/
+int open_id3_reader_mem(ID3READER *rd, const unsigned char *buf, size_t size) {
+	memset(rd, 0, sizeof(*rd));
+	rd->type = READER_BUF;
+	rd->fd = -1;
+	rd->base = buf;
+	rd->size = size;
+
+	return RET_OK;
+}
+
+
+/* open_id3_reader_stream ***************
+   pCvfdǂݍreaderpӂ
+   fetch_id3_readerŗvꂽ܂łɓǂ݁A
+   ǂ܂Ȃ̂ŁAfd̈ʒu̓^Ö̒Ŏ~܂
+
+   ߂lF(F0@sF-1)
+   ӁFgpclose_id3_readerŉ
+****************************************/
+int open_id3_reader_stream(ID3READER *rd, int fd) {
+	memset(rd, 0, sizeof(*rd));
+	rd->type = READER_STREAM;
+	rd->fd = fd;
+
+	return RET_OK;
+}
+
+
+/* close_id3_reader ***************************
+   open_id3_readerŊmۂ̈
+************************************************/
+void close_id3_reader(ID3READER *rd) {
+	if (rd->type == READER_MMAP) munmap((void *)rd->base, rd->size);
+	free(rd->buf);
+	memset(rd, 0, sizeof(*rd));
+}
+
+
+/* fetch_id3_reader ***************************
+   擪 n byte QƂł悤ɂ
+   mmapłΔ͈͂̊mF̂݁Apreadł
+   Ȃǉœǂݍ (streamłΑǂ)
+
+   ߂lF0 Ȃ-1
+************************************************/
+int fetch_id3_reader(ID3READER *rd, size_t n) {
+	unsigned char *p;
+	ssize_t ret;
+
+	if (n <= rd->size) return RET_OK;
+	if ((rd->type == READER_MMAP) || (rd->fd < 0)) return RET_ERROR;
+
+	p = realloc(rd->buf, n);
+	if (p == NULL) return RET_ERROR;
+	rd->buf = p;
+	rd->base = p;
+	if (rd->type == READER_BUF) {
+		ret = pread(rd->fd, rd->buf + rd->size, n - rd->size, rd->size);
+		if (ret > 0) rd->size += ret;
+		return (n <= rd->size) ? RET_OK : RET_ERROR;
+	}
+
+	// pCv͏ǂ߂Ȃ̂ŁA邩EOF܂ŌJԂ
+	while (rd->size < n) {
+		ret = read(rd->fd, rd->buf + rd->size, n - rd->size);
+		if ((ret < 0) && (errno == EINTR)) continue;
+		if (ret <= 0) break;
+		rd->size += ret;
+	}
+
+	return (n <= rd->size) ? RET_OK : RET_ERROR;
+}
+
+
+/* read_id3_header **************
+   headerɊef[^ǂݍ
+
+   ߂lFł0
+   ӁFread֐reader̈ʒuړ
+*********************************/
+int read_id3_header(ID3HEADER *header, ID3READER *rd) {
+	const unsigned char *p;
+
+	if (fetch_id3_reader(rd, rd->pos + ID3_HEADER_SIZE)) return RET_ERROR;
+	p = rd->base + rd->pos;
+
+	// id3
+	memcpy(header->id3, p, sizeof(header->id3));
+	p += sizeof(header->id3);
+
+	// version
+	memcpy(header->version, p, sizeof(header->version));
+	p += sizeof(header->version);
+
+	// flag
+	header->flag = *p++;
+
+	// size
+	memcpy(&(header->size), p, FOUR_BYTE);
+
+	// sizesynchsafeƓ`ł邽ߕϊ
+	header->size = FROM_SYNCHSAFE(header->size);
+	rd->pos += ID3_HEADER_SIZE;
+
+#ifdef DEBUG_ON
+	printf("id3 = %c%c%c\n", header->id3[0], header->id3[1], header->id3[2]);
+	printf("version = %02X%02X\n", header->version[0], header->version[1]);
+	printf("flag = %02X\n", header->flag);
+	printf("size = %08X\n", header->size);
+	printf("size(original) = %08X\n", REVERSE_ENDIAN(TO_SYNCHSAFE(header->size)));
+#endif
+
+	return RET_OK;
+}
+
+
+/* read_id3_extheader **************
+   headerɊef[^ǂݍ
+
+   ߂lFł0
+   ӁFread֐reader̈ʒuړ
+************************************/
+int read_id3_extheader(ID3EXTHEADER *header, ID3READER *rd) {
+	const unsigned char *p;
+	size_t len = FOUR_BYTE + sizeof(header->flag) + FOUR_BYTE;
+
+	if (fetch_id3_reader(rd, rd->pos + len)) return RET_ERROR;
+	p = rd->base + rd->pos;
+
+	// size
+	memcpy(&(header->size), p, FOUR_BYTE);
+
+	// flag
+	memcpy(header->flag, p + FOUR_BYTE, sizeof(header->flag));
+
+	// padding_size
+	memcpy(&(header->padding_size), p + FOUR_BYTE + sizeof(header->flag), FOUR_BYTE);
+
+	// crctO`FbN
+	if (header->flag[0] & EXT_FLAG_CRC) {
+		// crc ǂݍ
+		if (fetch_id3_reader(rd, rd->pos + len + sizeof(header->crc))) return RET_ERROR;
+		memcpy(header->crc, rd->base + rd->pos + len, sizeof(header->crc));
+		len += sizeof(header->crc);
+	}
+	rd->pos += len;
+
+	// size,padding_sizerbOGfBÂ߃gGfBAɕϊ
+	header->size = REVERSE_ENDIAN(header->size);
+	header->padding_size = REVERSE_ENDIAN(header->padding_size);
+
+#ifdef DEBUG_ON
+	printf("size = %08X\n", header->size);
+	printf("size(original) = %08X\n", REVERSE_ENDIAN(header->size));
+	printf("extflag = %02X%02X\n", header->flag[0], header->flag[1]);
+	printf("padding_size = %08X\n", header->padding_size);
+	printf("padding_size(original) = %08X\n", REVERSE_ENDIAN(header->padding_size));
+	printf("crc = %c%c%c%c\n", header->crc[0], header->crc[1], header->crc[2], header->crc[3]);
+#endif
+
+	return RET_OK;
+}
+
+
+/* read_id3_frame_header *********************
+   headerɊef[^ǂݍ
+
+   ߂lFł0
+   ӁFread֐reader̈ʒuړ
+**********************************************/
+int read_id3_frame_header(ID3FRAMEHEADER *header, ID3READER *rd) {
+	const unsigned char *p;
+
+	if (fetch_id3_reader(rd, rd->pos + ID3_FRAME_SIZE)) return RET_ERROR;
+	p = rd->base + rd->pos;
+
+	// id
+	memcpy(header->id, p, sizeof(header->id));
+	p += sizeof(header->id);
+
+	// size
+	memcpy(&(header->size), p, FOUR_BYTE);
+	p += FOUR_BYTE;
+
+	// flag
+	memcpy(header->flag, p, sizeof(header->flag));
+
+	// sizerbOGfBÂ߃gGfBAɕϊ
+	header->size = REVERSE_ENDIAN(header->size);
+	rd->pos += ID3_FRAME_SIZE;
+
+#ifdef DEBUG_ON
+	printf("id = %c%c%c%c\n", header->id[0], header->id[1], header->id[2], header->id[3]);
+	printf("size = %08X\n", header->size);
+	printf("size(original) = %08X\n", REVERSE_ENDIAN(header->size));
+	printf("flag = %02X%02X\n", header->flag[0], header->flag[1]);
+#endif
+
+	return RET_OK;
+}
+
+
+/* write_id3 header **************
+   ߂lF0 G[1
+*****************************************/
+int write_id3_header(const ID3HEADER *header, FILE *fp) {
+	unsigned int headersize;
+
+	if (fp == NULL) return RET_ERROR;
+
+	// synchsafe`ɕϊ
+	headersize = TO_SYNCHSAFE(header->size);
+
+	if (1 != fwrite(header->id3, sizeof(header->id3), 1, fp)) return RET_ERROR;
+	if (1 != fwrite(header->version, sizeof(header->version), 1, fp)) return RET_ERROR;
+	if (1 != fwrite(&(header->flag), sizeof(header->flag), 1, fp)) return RET_ERROR;
+	if (1 != fwrite(&headersize, FOUR_BYTE, 1, fp)) return RET_ERROR;
+
+#ifdef DEBUG2_ON
+	printf("header->size = %08X : headersize = %08X\n", header->size, headersize);
+	printf("id3s = %d : vers = %d : flas = %d : sizs = %d\n", sizeof(header->id3), sizeof(header->version), sizeof(header->flag), sizeof(header->size));
+#endif
+	
+	return RET_OK;
+}
+
+
+/* write_id3 extheader ******************
+   ߂lF0 G[1
+*****************************************/
+int write_id3_extheader(const ID3EXTHEADER *header, FILE *fp) {
+	unsigned int headersize;
+	unsigned int paddingsize;
+	
+	if (fp == NULL) return RET_ERROR;
+	
+	// gGfBArbOGfBAɖ߂
+	headersize = REVERSE_ENDIAN(header->size);
+	paddingsize = REVERSE_ENDIAN(header->padding_size);
+
+	if (1 != fwrite(&headersize, FOUR_BYTE, 1, fp)) return RET_ERROR;
+	if (1 != fwrite(header->flag, sizeof(header->flag), 1, fp)) return RET_ERROR;
+	if (1 != fwrite(&paddingsize, FOUR_BYTE, 1, fp)) return RET_ERROR;
+
+	if (header->flag[0] & EXT_FLAG_CRC) {
+		if (1 != fwrite(header->crc, sizeof(header->crc), 1, fp)) return RET_ERROR;
+	}
+
+	return RET_OK;
+}
+
+
+/* write_id3 frame *****************************
+   data: t[̃f[^ (header->size byte)
+   ߂lF0 G[1
+************************************************/
+int write_id3_frame(const ID3FRAMEHEADER *header, const unsigned char *data, FILE *fpw) {
+	unsigned int headersize;
+
+	if ((data == NULL) || (fpw == NULL)) return RET_ERROR;
+
+	// gGfBArbOGfBAɖ߂
+	headersize = REVERSE_ENDIAN(header->size);
+
+	if (1 != fwrite(header->id, sizeof(header->id), 1, fpw)) return RET_ERROR;
+	if (1 != fwrite(&headersize, FOUR_BYTE, 1, fpw)) return RET_ERROR;
+	if (1 != fwrite(&(header->flag), sizeof(header->flag), 1, fpw)) return RET_ERROR;
+
+	// framẽf[^o
+	if (header->size != fwrite(data, 1, header->size, fpw)) return RET_ERROR;
+	
+	return RET_OK;
+}
+
+
+/* write_id3 repair_apic_frame **********
+   data: t[̃f[^ (header->size byte)
+   ߂lF0 G[1
+*****************************************/
+int write_id3_repair_apic_frame(const ID3FRAMEHEADER *header, const unsigned char *data, FILE *fpw) {
+	unsigned int headersize;
+
+	if ((data == NULL) || (fpw == NULL)) return RET_ERROR;
+	if (header->size < 5) return RET_ERROR;
+
+	headersize = header->size -1;
+	headersize = REVERSE_ENDIAN(headersize);	// gGfBArbOGfBAɖ߂
+
+	if (1 != fwrite(header->id, sizeof(header->id), 1, fpw)) return RET_ERROR;
+	if (1 != fwrite(&headersize, FOUR_BYTE, 1, fpw)) return RET_ERROR;
+	if (1 != fwrite(&(header->flag), sizeof(header->flag), 1, fpw)) return RET_ERROR;
+
+	// S~`FbN
+	if (data[4] != 0) {
+		fprintf(stderr, "not [ima ge]. char is %c (%02X).\n", data[4], data[4]);
+		return RET_ERROR;
+	}
+
+	//  encode"ima"܂ŏo
+	if (4 != fwrite(data, 1, 4, fpw)) return RET_ERROR;
+
+	// cf[^o(o4byteƃS~̕sizej
+	if ((header->size -4 -1) != fwrite(data +4 +1, 1, header->size -4 -1, fpw)) return RET_ERROR;
+
+	return RET_OK;
+}
+
+
+/* get_id3_apic_type ********************
+   apictypeapictypeZbg
+
+   data: APICt[̃f[^
+   size: f[^byte
+   ߂lF0 G[-1
+*****************************************/
+int get_id3_apic_type(const unsigned char *data, unsigned int size, unsigned char *apictype) {
+	unsigned int cnt;
+
+	if (data == NULL) return RET_ERROR;
+
+	// encode(1byte)̌AS~ꏊ̐悩mimetypȅI[T
+	for (cnt = 1 + 4; cnt < size; cnt++) {
+		if (data[cnt] == 0) break;
+		if (cnt - 1 >= MIMETYPE_MAXSIZE) return RET_ERROR;
+	}
+
+	// typeǂݍ
+	if (cnt + 1 >= size) return RET_ERROR;
+	*apictype = data[cnt + 1];
+
+	if (*apictype >= PICTURE_TYPE_NUM) {
+		fprintf(stderr, "This APIC type (%02X) is undefined.\n", *apictype);
+		return RET_ERROR;
+	}
+
+#ifdef DEBUG2_ON
+	printf("pictype = %02X\n", *apictype);
+#endif
+	return RET_OK;
+}
+
+
+/* get_id3_apic_picture *****************
+   APICt[̉摜f[^̈ʒuposɃZbg
+   (mimetypȅI[get_id3_apic_typeƓS~̐悩T)
+
+   data: APICt[̃f[^
+   size: f[^byte
+   ߂lF0 G[-1
+*****************************************/
+int get_id3_apic_picture(const unsigned char *data, unsigned int size, unsigned int *pos) {
+	unsigned int cnt;
+
+	if ((data == NULL) || (size < 1)) return RET_ERROR;
+
+	for (cnt = 1 + 4; cnt < size; cnt++) {
+		if (data[cnt] == 0) break;
+		if (cnt - 1 >= MIMETYPE_MAXSIZE) return RET_ERROR;
+	}
+	cnt += 2; // mimetypȅI[picture type
+
+	// description̏I[ (UTF-162bytePʂ$00 00)
+	if ((data[0] == 1) || (data[0] == 2)) {
+		for (; cnt + 1 < size; cnt += 2) {
+			if ((data[cnt] == 0) && (data[cnt + 1] == 0)) break;
+		}
+		cnt += 2;
+	}
+	else {
+		for (; cnt < size; cnt++) {
+			if (data[cnt] == 0) break;
+		}
+		cnt += 1;
+	}
+	if (cnt > size) return RET_ERROR;
+
+	*pos = cnt;
+	return RET_OK;
+}
+
+
+/* hash_id3_data ************************
+   datasize byte64bithash
+   (8byte|ZōBÍprł͂Ȃ)
+   ߂lFhash (0́usvɎĝŕԂȂ)
+****************************************/
+unsigned long long hash_id3_data(const void *data, size_t size, unsigned long long seed) {
+	const unsigned char *p = data;
+	unsigned long long h = seed ^ (size * HASH_PRIME1);
+	unsigned long long w;
+	size_t i;
+
+	for (i = 0; i + sizeof(w) <= size; i += sizeof(w)) {
+		memcpy(&w, p + i, sizeof(w));
+		h ^= w * HASH_PRIME2;
+		h = ((h << 31) | (h >> 33)) * HASH_PRIME1;
+	}
+	w = 0;
+	memcpy(&w, p + i, size - i);
+	h ^= w * HASH_PRIME2;
+
+	// Sbitɍsn悤ɍ
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	return h ? h : 1;
+}
+	
+
+/* check_id3_mime_type ******************
+   mimetype  "ima ge"ƂȂĂȂ`FbN
+
+   data: APICt[̃f[^
+   size: f[^byte
+   ߂lF0 C1 G[-1
+*****************************************/
+int check_id3_mime_type(const unsigned char *data, unsigned int size) {
+	unsigned int cnt;
+
+	if (data == NULL) return RET_ERROR;
+	if (size < 1 + 4) return RET_ERROR;
+
+	// S~`FbN
+	if (data[4] == 0) return RET_FAILURE;
+
+	// mimetypeI[`FbN
+	for (cnt = 1 + 4; cnt < size; cnt++) {
+		if (data[cnt] == 0) break;
+		if (cnt - 1 >= MIMETYPE_MAXSIZE) return RET_ERROR;
+	}
+	if (cnt >= size) return RET_ERROR;
+
+#ifdef DEBUG_ON
+	printf("mimetype = %s\n", (const char *)data + 1);
+#endif
+	return RET_OK;
+}
+
+
+/* add_id3_rule *************************
+   t[id̏option->ruleɉ
+   idɂΒu (ォw肵D)
+   rulefourcc̏ɕۂAget_id3_ruleœ񕪒T
+
+   id: 4̃t[ID (A-Z 0-9)
+   action: RULE_KEEP / RULE_DELETE / RULE_PATCH
+   ߂lF0 G[-1
+*****************************************/
+int add_id3_rule(ID3OPTION *option, const char *id, int action) {
+	unsigned int fourcc;
+	int i, j;
+
+	for (i = 0; i < ID3_FRAME_ID_SIZE; i++) {
+		if (! (((id[i] >= 'A') && (id[i] <= 'Z')) || ((id[i] >= '0') && (id[i] <= '9')))) return RET_ERROR;
+	}
+	if (id[ID3_FRAME_ID_SIZE] != '\0') return RET_ERROR;
+	fourcc = ID3_FOURCC(id);
+
+	for (i = 0; (i < option->rulenum) && (option->rule[i].fourcc < fourcc); i++);
+	if ((i == option->rulenum) || (option->rule[i].fourcc != fourcc)) {
+		if (option->rulenum >= RULE_MAX) return RET_ERROR;
+		for (j = option->rulenum; j > i; j--) option->rule[j] = option->rule[j - 1];
+		option->rulenum++;
+	}
+	option->rule[i].fourcc = fourcc;
+	option->rule[i].action = action;
+
+	// 폜scaňʂɊ֌WȂt[𑖍
+	option->flag &= ~OPTFLAG_DELETE;
+	for (i = 0; i < option->rulenum; i++) {
+		if (option->rule[i].action == RULE_DELETE) option->flag |= OPTFLAG_DELETE;
+	}
+
+	return RET_OK;
+}
+
+
+/* get_id3_rule *************************
+   fourcc̃t[̏Ԃ
+   ߂lFRULE_KEEP / RULE_DELETE / RULE_PATCH
+*****************************************/
+int get_id3_rule(const ID3OPTION *option, unsigned int fourcc) {
+	int lo = 0, hi = option->rulenum, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (option->rule[mid].fourcc < fourcc) lo = mid + 1;
+		else hi = mid;
+	}
+	if ((lo < option->rulenum) && (option->rule[lo].fourcc == fourcc)) return option->rule[lo].action;
+
+	return (fourcc == FOURCC_APIC) ? RULE_PATCH : RULE_KEEP;
+}
+
+
+/* check_id3_tag *******************************
+   ID3V2.3`̃t@Cł邩mF
+
+   ߂lFID3V2.3,1  Not,0
+************************************************/
+int check_id3_tag(const ID3HEADER *header) {
+	if (0 != strncmp(header->id3, ID3_HEADER_ID_CHECK, ID3_HEADER_ID_SIZE)) return 0;
+	if (header->version[0] != ID3_HEADER_VERSION_CHECK) return 0;
+	
+	return 1;
+}
+
+
+/* read_id3_tag *******************************
+   readerŃ^Ö(ID3_HEADER_SIZE + header.size byte)
+   QƂA"APIC"/"ima\0ge" 𑖍
+
+   type: reader̎ (READER_MMAP / READER_BUF)
+   ߂lF0 G[-1
+   ӁFgpfree_id3_tagŉ
+************************************************/
+int read_id3_tag(ID3TAG *tag, int fd, int type) {
+	memset(tag, 0, sizeof(*tag));
+	if (open_id3_reader(&(tag->reader), fd, type)) return RET_ERROR;
+
+	return parse_id3_tag(tag);
+}
+
+
+/* parse_id3_tag ******************************
+   pӍς݂tag->readerwb_Ɗgwb_ǂݍ݁A
+   ^Öscan_id3_tagő
+   񓯊ꂽ^O͉tag->bufɂ
+   t[ꗗwalk_id3_tagō쐬
+
+   ߂lF0 G[-1 (tag͉)
+           streamreader͓ǂ񂾕o悤Ɏc
+   ӁFgpfree_id3_tagŉ
+************************************************/
+int parse_id3_tag(ID3TAG *tag) {
+	ID3READER *rd = &(tag->reader);
+	ID3READER mem, keep;
+	unsigned int tagsize;
+
+	rd->pos = 0;
+
+	// wb_
+	if (read_id3_header(&(tag->header), rd)) goto READ_ID3_TAG_FORMAT_ERROR;
+	if (! check_id3_tag(&(tag->header))) goto READ_ID3_TAG_FORMAT_ERROR;
+	tagsize = ID3_HEADER_SIZE + tag->header.size;
+
+	// ^ÖŜQƂł悤ɂ
+	if (fetch_id3_reader(rd, tagsize)) {
+		fprintf(stderr, "The tag is larger than the file.\n");
+		goto READ_ID3_TAG_ERROR;
+	}
+	tag->buf = rd->base;
+	tag->bufsize = tagsize;
+	tag->tagsize = tagsize;
+
+	// 񓯊 (wb_ȍ~FF̌00܂Ă) 
+	if (tag->header.flag & FLAG_SYN) {
+		tag->syncbuf = malloc(tagsize);
+		if (tag->syncbuf == NULL) goto READ_ID3_TAG_ERROR;
+		memcpy(tag->syncbuf, rd->base, ID3_HEADER_SIZE);
+		tag->bufsize = ID3_HEADER_SIZE
+			+ decode_id3_unsync(tag->syncbuf + ID3_HEADER_SIZE, rd->base + ID3_HEADER_SIZE, tag->header.size);
+		tag->buf = tag->syncbuf;
+	}
+
+	// gwb_
+	open_id3_reader_mem(&mem, tag->buf, tag->bufsize);
+	mem.pos = ID3_HEADER_SIZE;
+	if (tag->header.flag & FLAG_EXT) {
+		if (read_id3_extheader(&(tag->extheader), &mem)) goto READ_ID3_TAG_ERROR;
+	}
+	tag->datapos = mem.pos;
+
+	// t[؂炸Ɍ₾Ă
+	scan_id3_tag(tag->buf + tag->datapos, tag->bufsize - tag->datapos, &(tag->scan));
+
+	return RET_OK;
+
+  READ_ID3_TAG_FORMAT_ERROR:
+	fprintf(stderr, "It doesn't correspond to this file format. Please let me read the file of the ID3v2.3 form. \n");
+  READ_ID3_TAG_ERROR:
+	if (rd->type == READER_STREAM) {
+		keep = *rd;
+		rd->buf = NULL;
+		free_id3_tag(tag);
+		tag->reader = keep;
+		return RET_ERROR;
+	}
+	free_id3_tag(tag);
+	return RET_ERROR;
+}
+
+
+/* free_id3_frames ****************************
+   t[Ɋmۂ̈(WJEk)
+************************************************/
+static void free_id3_frames(ID3TAG *tag) {
+	int i;
+
+	for (i = 0; i < tag->framenum; i++) {
+		free(tag->frame[i].unpacked);
+		free(tag->frame[i].packed);
+		tag->frame[i].unpacked = NULL;
+		tag->frame[i].packed = NULL;
+	}
+}
+
+
+/* walk_id3_tag *******************************
+   parse_id3_tagς݂̃^Ot[ꗗ쐬
+
+   ߂lF0 G[-1
+************************************************/
+int walk_id3_tag(ID3TAG *tag) {
+	ID3READER mem;
+	ID3READER *rd = &mem;
+	ID3FRAME *frame;
+	unsigned int end, tagsize;
+
+	// 񓯊悤ɓǂ߂悤tag->bufǂ
+	tagsize = tag->bufsize;
+	open_id3_reader_mem(rd, tag->buf, tagsize);
+	rd->pos = tag->datapos;
+	free_id3_frames(tag);
+	tag->framenum = 0;
+
+	// padding̈悩DATÄɗ܂Ńt[ǂ
+	end = tagsize - tag->extheader.padding_size;
+	if ((tag->extheader.padding_size > tagsize) || (end < rd->pos)) end = rd->pos;
+	while (rd->pos + ID3_FRAME_SIZE <= end) {
+		if (rd->base[rd->pos] == 0) break; // padding̈N
+
+		if (tag->framenum >= tag->framemax) {
+			tag->framemax = tag->framemax ? tag->framemax * 2 : FRAME_LIST_SIZE;
+			frame = realloc(tag->frame, sizeof(ID3FRAME) * tag->framemax);
+			if (frame == NULL) return RET_ERROR;
+			tag->frame = frame;
+		}
+		frame = &(tag->frame[tag->framenum]);
+		memset(frame, 0, sizeof(*frame));
+		frame->pos = rd->pos;
+
+		if (read_id3_frame_header(&(frame->header), rd)) return RET_ERROR;
+		frame->fourcc = ID3_FOURCC(frame->header.id);
+		if (frame->header.size > tagsize - rd->pos) {
+			fprintf(stderr, "The size of %c%c%c%c frame exceeds the tag.\n",
+					frame->header.id[0], frame->header.id[1], frame->header.id[2], frame->header.id[3]);
+			return RET_ERROR;
+		}
+		tag->framenum++;
+		rd->pos += frame->header.size;
+	}
+	tag->paddingpos = rd->pos;
+
+	return RET_OK;
+}
+
+
+/* check_id3_scan *****************************
+   scan_id3_taǧʂt[𑖍Kv邩f
+   APIC "ima\0ge" ΏC镨͖
+   (kꂽAPIC͒ȂƕȂ)
+
+   ߂lFKv1 sv0
+************************************************/
+int check_id3_scan(const ID3TAG *tag, const ID3OPTION *option) {
+	if (option->flag & OPTFLAG_DELETE) return 1;
+	if ((tag->header.flag & FLAG_SYN) && (option->flag & OPTFLAG_NOUNSYNC)) return 1;
+	if (tag->scan.mime || tag->scan.apicnul || tag->scan.apiccomp) return 1;
+	if ((option->flag & (OPTFLAG_REPETITION | OPTFLAG_DEDUP)) && (tag->scan.apic >= 2)) return 1;
+	if ((option->flag & OPTFLAG_MAXAPIC) && tag->scan.apic) return 1;
+	if ((option->flag & (OPTFLAG_PADDING | OPTFLAG_MAXPADDING)) && !(option->flag & OPTFLAG_INPLACE)) return 1;
+
+	return 0;
+}
+
+
+/* free_id3_tag *******************************
+   read_id3_tagŊmۂ̈
+************************************************/
+void free_id3_tag(ID3TAG *tag) {
+	close_id3_reader(&(tag->reader));
+	free(tag->syncbuf);
+	if (tag->frame != NULL) free_id3_frames(tag);
+	free(tag->frame);
+	memset(tag, 0, sizeof(*tag));
+}
+
+
+/* move_id3_tag *******************************
+   eʂ̃t@Cfd^OQƂ
+   (reflink.bakǂ݁At@C֏ޏꍇɎg)
+
+   ߂lF0 G[-1
+************************************************/
+int move_id3_tag(ID3TAG *tag, int fd) {
+	ID3READER rd;
+
+	// ɓǂݍݍς݂łfdւ邾
+	if (tag->reader.type != READER_MMAP) {
+		tag->reader.fd = fd;
+		return RET_OK;
+	}
+
+	if (open_id3_reader(&rd, fd, READER_MMAP)) return RET_ERROR;
+	if (fetch_id3_reader(&rd, tag->tagsize)) {
+		close_id3_reader(&rd);
+		return RET_ERROR;
+	}
+	close_id3_reader(&(tag->reader));
+	tag->reader = rd;
+	if (tag->syncbuf == NULL) tag->buf = rd.base;
+
+	return RET_OK;
+}
+
+
+/* check_id3_crc ************************
+   gwb_CRC32ƃt[̈(gwb_`padding̈̑O)ׂ
+   񓯊ꂽ^O͉Ŕׂ
+   CRCΉȂ
+
+   ߂lFv0 sv-1
+****************************************/
+static int check_id3_crc(const ID3TAG *tag) {
+	unsigned int crc, old;
+
+	if (! ((tag->header.flag & FLAG_EXT) && (tag->extheader.flag[0] & EXT_FLAG_CRC))) return RET_OK;
+
+	memcpy(&old, tag->extheader.crc, FOUR_BYTE);
+	old = REVERSE_ENDIAN(old);
+	crc = crc32_id3_data(tag->buf + tag->datapos, tag->paddingpos - tag->datapos, 0);
+	if (crc != old) {
+		fprintf(stderr, "The CRC of the tag doesn't match (%08X != %08X).\n", crc, old);
+		return RET_ERROR;
+	}
+
+	return RET_OK;
+}
+
+
+/* get_id3_frame_extra ******************
+   f[^̐擪ɂǉbyte (kEÍEO[vID)
+****************************************/
+static unsigned int get_id3_frame_extra(const ID3FRAME *frame) {
+	unsigned int extra = 0;
+
+	if (frame->header.flag[1] & FRAME_FLAG_COMP) extra += FOUR_BYTE;
+	if (frame->header.flag[1] & FRAME_FLAG_ENC) extra += 1;
+	if (frame->header.flag[1] & FRAME_FLAG_GROUP) extra += 1;
+	return extra;
+}
+
+
+/* get_id3_frame_payload ****************
+   t[̖{(ǉbytě)Ԃ
+   kt[͂ŏ߂zlibœWJAframeɎcĂ
+   ({̂ǂޕKv̖t[͓WJȂ)
+
+   ߂lF0 ǂ߂Ȃ(ÍEĂ)1 G[-1
+****************************************/
+static int get_id3_frame_payload(const ID3TAG *tag, ID3FRAME *frame, const unsigned char **data, unsigned int *size) {
+	const unsigned char *p = ID3_FRAME_DATA(tag, frame);
+	unsigned int extra = get_id3_frame_extra(frame);
+	unsigned int rawsize;
+	uLongf len;
+
+	if (frame->header.flag[1] & FRAME_FLAG_ENC) return RET_FAILURE; // ̂œǂ܂Ȃ
+	if (extra > frame->header.size) return RET_FAILURE;
+	if (! (frame->header.flag[1] & FRAME_FLAG_COMP)) {
+		*data = p + extra;
+		*size = frame->header.size - extra;
+		return RET_OK;
+	}
+
+	if (frame->unpacked == NULL) {
+		memcpy(&rawsize, p, FOUR_BYTE);
+		rawsize = REVERSE_ENDIAN(rawsize);
+		if (rawsize > FRAME_UNPACK_MAX) return RET_FAILURE;
+		frame->unpacked = malloc(rawsize ? rawsize : 1);
+		if (frame->unpacked == NULL) return RET_ERROR;
+		len = rawsize;
+		if ((Z_OK != uncompress(frame->unpacked, &len, p + extra, frame->header.size - extra)) || (len != rawsize)) {
+			fprintf(stderr, "The compressed %.4s frame is broken.\n", frame->header.id);
+			free(frame->unpacked);
+			frame->unpacked = NULL;
+			return RET_FAILURE;
+		}
+		frame->unpackedsize = rawsize;
+	}
+	*data = frame->unpacked;
+	*size = frame->unpackedsize;
+	return RET_OK;
+}
+
+
+/* pack_id3_apic_frame ******************
+   MIMETYPECAPICt[̃f[^frame->packedɍ
+   ǉbyte͌̂܂ܕtAkt[͈k
+   data: get_id3_frame_payloadœ{
+
+   ߂lF(F0@sF-1)
+****************************************/
+static int pack_id3_apic_frame(const ID3TAG *tag, ID3FRAME *frame, const unsigned char *data, unsigned int size) {
+	unsigned int extra = get_id3_frame_extra(frame);
+	unsigned int rawsize;
+	unsigned char *body;
+	uLongf len;
+
+	if (size < 1 + 4 + 1) return RET_ERROR;
+
+	// encode"ima"̌̃S~{
+	body = malloc(size - 1);
+	if (body == NULL) return RET_ERROR;
+	memcpy(body, data, 4);
+	memcpy(body + 4, data + 4 + 1, size - 4 - 1);
+
+	if (! (frame->header.flag[1] & FRAME_FLAG_COMP)) {
+		frame->packed = malloc(extra + size - 1);
+		if (frame->packed == NULL) goto PACK_ID3_APIC_FRAME_ERROR;
+		memcpy(frame->packed, ID3_FRAME_DATA(tag, frame), extra);
+		memcpy(frame->packed + extra, body, size - 1);
+		frame->packedsize = extra + size - 1;
+		free(body);
+		return RET_OK;
+	}
+
+	len = compressBound(size - 1);
+	frame->packed = malloc(extra + len);
+	if (frame->packed == NULL) goto PACK_ID3_APIC_FRAME_ERROR;
+	memcpy(frame->packed, ID3_FRAME_DATA(tag, frame), extra);
+	rawsize = size - 1;
+	rawsize = REVERSE_ENDIAN(rawsize);
+	memcpy(frame->packed, &rawsize, FOUR_BYTE);  // WJ̃TCY
+	if (Z_OK != compress2(frame->packed + extra, &len, body, size - 1, Z_DEFAULT_COMPRESSION)) goto PACK_ID3_APIC_FRAME_ERROR;
+	frame->packedsize = extra + len;
+	free(body);
+	return RET_OK;
+
+  PACK_ID3_APIC_FRAME_ERROR:
+	free(frame->packed);
+	frame->packed = NULL;
+	free(body);
+	return RET_ERROR;
+}
+
+
+/* get_id3_repair_size ******************
+   t[ꗗet[̏ƁA^O
+   padding byte(opt [--padding] [--max-padding])肷
+   CKvȂ 0 Ԃ
+
+   ߂lFC\z^OTCY
+*****************************************/
+unsigned int get_id3_repair_size(ID3TAG *tag, const ID3OPTION *option) {
+	ID3FRAME *frame;
+	const unsigned char *data;
+	unsigned int size;
+	unsigned int repairsize = 0;
+	unsigned int padding;
+	int i, ret;
+
+	memset(&(tag->report), 0, sizeof(tag->report));
+	repairsize = tag->bufsize - ID3_HEADER_SIZE; // 񓯊TCY
+
+	// ₪΃t[ꗗ炸ɏI
+	if (! check_id3_scan(tag, option)) return 0;
+	start_id3_stats(tag->stats, STATS_WALK);
+	ret = walk_id3_tag(tag);
+	stop_id3_stats(tag->stats, STATS_WALK);
+	if (ret) return RET_ERROR;
+
+	// CRC̍Ȃ^O͉Ă̂ŏȂ
+	if (check_id3_crc(tag)) return RET_ERROR;
+
+	start_id3_stats(tag->stats, STATS_APIC);
+
+	// t[ID̏1ň
+	for (i = 0; i < tag->framenum; i++) {
+		frame = &(tag->frame[i]);
+		frame->action = FRAME_KEEP;
+		frame->rule = get_id3_rule(option, frame->fourcc);
+
+		if (frame->rule == RULE_DELETE) {
+			repairsize -= ID3_FRAME_SIZE + frame->header.size;
+			frame->action = FRAME_DELETE;
+			tag->report.del++;
+#ifdef DEBUG_ON
+			printf("delete %c%c%c%c frame\n", frame->header.id[0], frame->header.id[1], frame->header.id[2], frame->header.id[3]);
+#endif
+		}
+		// 傫APIC (kt[WJɌ̃TCYŔׂ)
+		else if ((option->flag & OPTFLAG_MAXAPIC) && (frame->fourcc == FOURCC_APIC) && (frame->rule == RULE_PATCH)
+				 && (ID3_FRAME_SIZE + frame->header.size > option->maxapic)) {
+			repairsize -= ID3_FRAME_SIZE + frame->header.size;
+			frame->action = FRAME_DELETE_LARGE;
+			tag->report.large++;
+		}
+	}
+
+	// dAPIC (pictype / 摜f[^)
+	if (option->flag & (OPTFLAG_REPETITION | OPTFLAG_DEDUP)) {
+		if (check_id3_apic_duplicate(tag, option)) goto GET_ID3_REPAIR_SIZE_ERROR;
+	}
+
+	// cAPICMIMETYPE`FbN
+	for (i = 0; i < tag->framenum; i++) {
+		frame = &(tag->frame[i]);
+#ifdef DEBUG_ON
+		printf("repairsize = %08X\n", repairsize);
+#endif
+		if (frame->action == FRAME_DELETE_REPETITION) {
+			repairsize -= ID3_FRAME_SIZE + frame->header.size;
+			tag->report.repetition++;
+			continue;
+		}
+		if (frame->action != FRAME_KEEP) continue;
+		if ((frame->fourcc != FOURCC_APIC) || (frame->rule != RULE_PATCH)) continue;
+
+		// Íœǂ߂Ȃt[͂̂܂܎c
+		ret = get_id3_frame_payload(tag, frame, &data, &size);
+		if (ret == RET_FAILURE) continue;
+		if (ret != RET_OK) goto GET_ID3_REPAIR_SIZE_ERROR;
+
+		ret = check_id3_mime_type(data, size);
+		if (ret == 1) {
+			// ǉbytêt[̓f[^蒼 (kƑ傫Ȃ鎖)
+			if (get_id3_frame_extra(frame) == 0) repairsize--;
+			else if (pack_id3_apic_frame(tag, frame, data, size)) goto GET_ID3_REPAIR_SIZE_ERROR;
+			else repairsize = repairsize - frame->header.size + frame->packedsize;
+			frame->action = FRAME_REPAIR_MIME;
+			tag->report.mime++;
+		}
+		else if (ret != 0) goto GET_ID3_REPAIR_SIZE_ERROR;
+	}
+	stop_id3_stats(tag->stats, STATS_APIC);
+
+	// t[̏
+	if (tag->stats != NULL) {
+		tag->stats->deleted += tag->report.del + tag->report.repetition + tag->report.large;
+		tag->stats->patched += tag->report.mime;
+		tag->stats->kept += tag->framenum - tag->report.del - tag->report.repetition - tag->report.large - tag->report.mime;
+	}
+
+	// padding̈ (in-placeł̓^OTCYςȂ̂Ō̂܂)
+	padding = tag->bufsize - tag->paddingpos;
+	tag->padding = padding;
+	if (! (option->flag & OPTFLAG_INPLACE)) {
+		if (option->flag & OPTFLAG_PADDING) tag->padding = option->padding;
+		if ((option->flag & OPTFLAG_MAXPADDING) && (tag->padding > option->maxpadding)) tag->padding = option->maxpadding;
+	}
+	repairsize = repairsize - padding + tag->padding;
+	if (repairsize > ID3_TAG_MAXSIZE) {
+		fprintf(stderr, "The tag exceeds the maximum size with the padding.\n");
+		return RET_ERROR;
+	}
+
+	// padding͍팸byteɊ܂߂Ȃ
+	tag->report.saved = (tag->header.size > repairsize) ? tag->header.size - repairsize : 0;
+	if ((tag->report.mime + tag->report.repetition + tag->report.del + tag->report.large == 0) && (tag->padding == padding)
+		&& !((tag->header.flag & FLAG_SYN) && (option->flag & OPTFLAG_NOUNSYNC))) repairsize = 0;
+	
+	return repairsize;
+
+  GET_ID3_REPAIR_SIZE_ERROR:
+	stop_id3_stats(tag->stats, STATS_APIC);
+	return RET_ERROR;
+}
+
+
+/* check_id3_apic_duplicate *************
+   폜ĂȂAPICdTA
+   2ڈȍ~FRAME_DELETE_REPETITIONɂ
+     opt [-r]      : pictype
+     opt [--dedup] : 摜f[^ (hashmemcmpŊm߂)
+   cԂ opt [--keep] ɏ]
+     KEEP_FIRST   : ^Ȍ
+     KEEP_LARGEST : t[傫 (傫Ȃ^Ȍ)
+     KEEP_SMALLEST: t[ (傫Ȃ^Ȍ)
+
+   ߂lF(F0@sF-1)
+*****************************************/
+int check_id3_apic_duplicate(ID3TAG *tag, const ID3OPTION *option) {
+	ID3FRAME *frame, *kept;
+	const unsigned char *data, *keptdata;
+	unsigned int size, keptsize;
+	int *order;
+	int num = 0, keepnum = 0;
+	int i, j, k, dup, ret;
+
+	order = malloc(sizeof(int) * (tag->framenum + 1));
+	if (order == NULL) return RET_ERROR;
+
+	// ̈ꗗAׂl߂Ă
+	for (i = 0; i < tag->framenum; i++) {
+		frame = &(tag->frame[i]);
+		if (frame->action != FRAME_KEEP) continue;
+		if ((frame->fourcc != FOURCC_APIC) || (frame->rule != RULE_PATCH)) continue;
+
+		// Íœǂ߂Ȃt[ׂ͔Ȃ
+		ret = get_id3_frame_payload(tag, frame, &data, &size);
+		if (ret == RET_FAILURE) continue;
+		if (ret != RET_OK) goto CHECK_ID3_APIC_DUPLICATE_ERROR;
+
+		if (option->flag & OPTFLAG_REPETITION) {
+			if (get_id3_apic_type(data, size, &(frame->pictype))) goto CHECK_ID3_APIC_DUPLICATE_ERROR;
+		}
+
+		// 摜f[^̈ʒuȂt[ׂ͔Ȃ
+		frame->picpos = 0;
+		if (option->flag & OPTFLAG_DEDUP) {
+			if (RET_OK == get_id3_apic_picture(data, size, &(frame->picpos))) {
+				frame->picsize = size - frame->picpos;
+				frame->pichash = hash_id3_data(data + frame->picpos, frame->picsize, 0);
+			}
+		}
+
+		// KEEP_LARGESTł͑傫AKEEP_SMALLESTł͏ɑ}
+		for (j = num; (option->keep != KEEP_FIRST) && (j > 0); j--) {
+			kept = &(tag->frame[order[j - 1]]);
+			if ((option->keep == KEEP_LARGEST) && (kept->header.size >= frame->header.size)) break;
+			if ((option->keep == KEEP_SMALLEST) && (kept->header.size <= frame->header.size)) break;
+			order[j] = order[j - 1];
+		}
+		order[j] = i;
+		num++;
+	}
+
+	// ct[1łdȂ΍폜
+	// (ct[order̐擪ɋl߂Ă)
+	for (i = 0; i < num; i++) {
+		frame = &(tag->frame[order[i]]);
+		dup = 0;
+		for (k = 0; (k < keepnum) && !dup; k++) {
+			kept = &(tag->frame[order[k]]);
+			if ((option->flag & OPTFLAG_REPETITION) && (kept->pictype == frame->pictype)) dup = 1;
+			if ((option->flag & OPTFLAG_DEDUP) && (kept->picpos != 0) && (frame->picpos != 0)
+				&& (kept->pichash == frame->pichash) && (kept->picsize == frame->picsize)) {
+				// ̈ꗗɓWJς݂Ȃ̂ŎsȂ
+				get_id3_frame_payload(tag, kept, &keptdata, &keptsize);
+				get_id3_frame_payload(tag, frame, &data, &size);
+				if (0 == memcmp(keptdata + kept->picpos, data + frame->picpos, frame->picsize)) dup = 1;
+			}
+		}
+		if (dup) {
+			frame->action = FRAME_DELETE_REPETITION;
+#ifdef DEBUG_ON
+			printf("delete repetition APIC\n");
+#endif
+			continue;
+		}
+		order[keepnum++] = order[i];
+	}
+
+	free(order);
+	return RET_OK;
+
+  CHECK_ID3_APIC_DUPLICATE_ERROR:
+	free(order);
+	return RET_ERROR;
+}
+
+
+/* crc_id3_frame_header ***********************
+   ot[wb_(TCYsize)crcɑ
+   ߂lFcrc
+***********************************************/
+static unsigned int crc_id3_frame_header(const ID3FRAMEHEADER *header, unsigned int size, unsigned int crc) {
+	unsigned char buf[ID3_FRAME_SIZE];
+
+	size = REVERSE_ENDIAN(size);
+	memcpy(buf, header->id, sizeof(header->id));
+	memcpy(buf + sizeof(header->id), &size, FOUR_BYTE);
+	memcpy(buf + sizeof(header->id) + FOUR_BYTE, header->flag, sizeof(header->flag));
+	return crc32_id3_data(buf, ID3_FRAME_SIZE, crc);
+}
+
+
+/* write_id3_frames ***************************
+   get_id3_repair_sizeŌ肵ɏ]
+   t[o
+   crc: NULLłȂΏot[CRC32𑱂ČvZ
+
+   ߂lF(F0@sF-1)
+***********************************************/
+int write_id3_frames(FILE *fpw, const ID3TAG *tag, const ID3JOB *job, unsigned int *crc) {
+	const ID3FRAME *frame;
+	const unsigned char *data;
+	ID3FRAMEHEADER header;
+	int i;
+
+	for (i = 0; i < tag->framenum; i++) {
+		frame = &(tag->frame[i]);
+
+		switch (frame->action) {
+		case FRAME_DELETE:
+		case FRAME_DELETE_REPETITION:
+			// 폜o
+			if (job->option->flag & OPTFLAG_VERBOSE) {
+				fprintf(job->log, "%s : delete frame (%.4s) %08X - %08X\n",
+					   job->filename, frame->header.id,
+					   frame->pos, frame->pos + ID3_FRAME_SIZE + frame->header.size);
+			}
+			break;
+		case FRAME_DELETE_LARGE:
+			if (job->option->flag & OPTFLAG_VERBOSE) {
+				fprintf(job->log, "%s : delete large APIC frame (%u bytes) %08X - %08X\n",
+					   job->filename, ID3_FRAME_SIZE + frame->header.size,
+					   frame->pos, frame->pos + ID3_FRAME_SIZE + frame->header.size);
+			}
+			break;
+		case FRAME_REPAIR_MIME:
+			// Co
+			if (job->option->flag & OPTFLAG_VERBOSE) {
+				fprintf(job->log, "%s : repair APIC frame (ima ge->image) %08X - %08X\n",
+					   job->filename, frame->pos, frame->pos + ID3_FRAME_SIZE + frame->header.size);
+			}
+			if (frame->packed != NULL) {
+				header = frame->header;
+				header.size = frame->packedsize;
+				if (write_id3_frame(&header, frame->packed, fpw)) return RET_ERROR;
+				if (crc != NULL) {
+					*crc = crc_id3_frame_header(&header, header.size, *crc);
+					*crc = crc32_id3_data(frame->packed, frame->packedsize, *crc);
+				}
+				break;
+			}
+			data = ID3_FRAME_DATA(tag, frame);
+			if (write_id3_repair_apic_frame(&(frame->header), data, fpw)) return RET_ERROR;
+			if (crc != NULL) {
+				// "ima"̌̃S~
+				*crc = crc_id3_frame_header(&(frame->header), frame->header.size - 1, *crc);
+				*crc = crc32_id3_data(data, 4, *crc);
+				*crc = crc32_id3_data(data + 4 + 1, frame->header.size - 4 - 1, *crc);
+			}
+			break;
+		default:
+			if (write_id3_frame(&(frame->header), ID3_FRAME_DATA(tag, frame), fpw)) return RET_ERROR;
+			// ̃wb_炻̂܂
+			if (crc != NULL) *crc = crc32_id3_data(tag->buf + frame->pos, ID3_FRAME_SIZE + frame->header.size, *crc);
+			break;
+		}
+	}
+
+	return RET_OK;
+}
+
+
+/* write_zero **********************************
+   fpw 0  n byte o
+
+   ߂lF(F0@sF-1)
+***********************************************/
+int write_zero(FILE *fpw, size_t n) {
+	static const char zero[STREAM_BUF_SIZE];
+	size_t len;
+
+	while (n > 0) {
+		len = (n > STREAM_BUF_SIZE) ? STREAM_BUF_SIZE : n;
+		if (len != fwrite(zero, 1, len, fpw)) return RET_ERROR;
+		n -= len;
+	}
+
+	return RET_OK;
+}
+
+
+/* write_id3_ext_frames **********************
+   gwb_()ƃt[o
+   CRCΉ̒lŏAt[oȂvZ
+   Ōɏ߂ (fpwseekłȂ΃ɏĂʂ)
+
+   ߂lF(F0@sF-1)
+***********************************************/
+static int write_id3_ext_frames(FILE *fpw, const ID3TAG *tag, const ID3EXTHEADER *extheader, const ID3JOB *job) {
+	ID3EXTHEADER ext;
+	FILE *fp;
+	char *body = NULL;
+	size_t len = 0;
+	unsigned int crc = 0, old;
+	off_t crcpos, end;
+	int ret;
+
+	if (! (tag->header.flag & FLAG_EXT)) return write_id3_frames(fpw, tag, job, NULL);
+	if (! (extheader->flag[0] & EXT_FLAG_CRC)) {
+		if (write_id3_extheader(extheader, fpw)) return RET_ERROR;
+		return write_id3_frames(fpw, tag, job, NULL);
+	}
+
+	// pCv
+	if (ftello(fpw) < 0) {
+		fp = open_memstream(&body, &len);
+		if (fp == NULL) return RET_ERROR;
+		ret = write_id3_ext_frames(fp, tag, extheader, job);
+		if (fclose(fp) || ret || (len != fwrite(body, 1, len, fpw))) ret = RET_ERROR;
+		free(body);
+		return ret;
+	}
+
+	ext = *extheader;
+	memset(ext.crc, 0, sizeof(ext.crc));
+	if (write_id3_extheader(&ext, fpw)) return RET_ERROR;
+	crcpos = ftello(fpw) - sizeof(ext.crc);
+	if (write_id3_frames(fpw, tag, job, &crc)) return RET_ERROR;
+
+	if (job->option->flag & OPTFLAG_VERBOSE) {
+		memcpy(&old, extheader->crc, FOUR_BYTE);
+		old = REVERSE_ENDIAN(old);
+		fprintf(job->log, "%s : crc %08X -> %08X\n", job->filename, old, crc);
+	}
+
+	// ̒l
+	if (job->stats != NULL) job->stats->seeks += 2;
+	end = ftello(fpw);
+	crc = REVERSE_ENDIAN(crc);
+	if ((end < 0) || fseeko(fpw, crcpos, SEEK_SET)) return RET_ERROR;
+	if (1 != fwrite(&crc, FOUR_BYTE, 1, fpw)) return RET_ERROR;
+	if (fseeko(fpw, end, SEEK_SET)) return RET_ERROR;
+
+	return RET_OK;
+}
+
+
+/* write_id3_body ****************************
+   C̃^Ö̃wb_ȍ~(gwb_`padding̈)o
+   padding̈tag->padding byteɂ
+
+   ߂lF(F0@sF-1)
+***********************************************/
+static int write_id3_body(FILE *fpw, const ID3TAG *tag, const ID3JOB *job) {
+	ID3EXTHEADER extheader;
+	unsigned int padding = tag->bufsize - tag->paddingpos;
+
+	// gwb_ (paddingςꍇpadding̈̃TCYς) ƃt[
+	extheader = tag->extheader;
+	if (tag->padding != padding) extheader.padding_size = tag->padding;
+	if (write_id3_ext_frames(fpw, tag, &extheader, job)) return RET_ERROR;
+
+	// pfBÖ͕ςȂ΃obt@珑o
+	if (tag->padding == padding) {
+		if (padding != fwrite(tag->buf + tag->paddingpos, 1, padding, fpw)) return RET_ERROR;
+		return RET_OK;
+	}
+	if (job->option->flag & OPTFLAG_VERBOSE) {
+		fprintf(job->log, "%s : padding %u -> %u\n", job->filename, padding, tag->padding);
+	}
+	if (write_zero(fpw, tag->padding)) return RET_ERROR;
+
+	return RET_OK;
+}
+
+
+/* write_id3_tag_unsync ***********************
+   wb_ȍ~ɏoĂ񓯊A
+   ̃TCỸwb_Ƌɏo
+
+   ߂lF(F0@sF-1)
+***********************************************/
+static int write_id3_tag_unsync(FILE *fpw, const ID3TAG *tag, ID3HEADER *header, const ID3JOB *job) {
+	FILE *fp;
+	char *body = NULL;
+	unsigned char *sync = NULL;
+	size_t len = 0, synclen;
+	int ret;
+
+	fp = open_memstream(&body, &len);
+	if (fp == NULL) return RET_ERROR;
+	ret = write_id3_body(fp, tag, job);
+	if (fclose(fp) || ret) goto WRITE_ID3_TAG_UNSYNC_ERROR;
+
+	sync = malloc(UNSYNC_ENCODE_MAX(len));
+	if (sync == NULL) goto WRITE_ID3_TAG_UNSYNC_ERROR;
+	synclen = encode_id3_unsync(sync, (const unsigned char *)body, len);
+	if (synclen > ID3_TAG_MAXSIZE) {
+		fprintf(stderr, "The unsynchronised tag exceeds the maximum size.\n");
+		goto WRITE_ID3_TAG_UNSYNC_ERROR;
+	}
+
+	header->size = synclen;
+	if (write_id3_header(header, fpw)) goto WRITE_ID3_TAG_UNSYNC_ERROR;
+	if (synclen != fwrite(sync, 1, synclen, fpw)) goto WRITE_ID3_TAG_UNSYNC_ERROR;
+
+	free(sync);
+	free(body);
+	return RET_OK;
+
+  WRITE_ID3_TAG_UNSYNC_ERROR:
+	free(sync);
+	free(body);
+	return RET_ERROR;
+}
+
+
+/* write_id3_tag ******************************
+   C̃^Ö(wb_`padding̈)o
+   padding̈tag->padding byteɂ
+   񓯊ꂽ^O͔񓯊
+   (opt [--no-unsync] łΉ܂܏o)
+
+   ߂lF(F0@sF-1)
+***********************************************/
+int write_id3_tag(FILE *fpw, const ID3TAG *tag, unsigned int headersize, const ID3JOB *job) {
+	ID3HEADER header;
+
+	// wb_
+	header = tag->header;
+	header.size = headersize; 	// wb_TCYC̒lɕύX
+	if (header.flag & FLAG_SYN) {
+		if (! (job->option->flag & OPTFLAG_NOUNSYNC)) return write_id3_tag_unsync(fpw, tag, &header, job);
+		header.flag &= ~FLAG_SYN;
+	}
+	if (write_id3_header(&header, fpw)) return RET_ERROR;
+
+	return write_id3_body(fpw, tag, job);
+}
+
+
+/* write_id3_tag_cut **************************
+   ̃^Ö悩cut byteTCYɂȂ悤A
+   ̎cpadding̈ɉ񂵂^Öo
+   񓯊ꂽ^O͉܂܏o
+   (Ōbytepadding̈ɉ)
+
+   ߂lF(F0@sF-1)
+***********************************************/
+static int write_id3_tag_cut(FILE *fpw, const ID3TAG *tag, unsigned int headersize, unsigned int cut, const ID3JOB *job) {
+	ID3HEADER header;
+	ID3EXTHEADER extheader;
+	unsigned int shrink;
+
+	if (headersize > tag->header.size) return RET_ERROR;
+	shrink = tag->header.size - headersize;
+	if (cut > shrink) return RET_ERROR;
+
+	// wb_ (cut̕)
+	header = tag->header;
+	header.flag &= ~FLAG_SYN;
+	header.size -= cut;
+	if (write_id3_header(&header, fpw)) return RET_ERROR;
+
+	// gwb_ (padding̈̃TCY𑝂₷) ƃt[
+	extheader = tag->extheader;
+	extheader.padding_size += shrink - cut;
+	if (write_id3_ext_frames(fpw, tag, &extheader, job)) return RET_ERROR;
+
+	// padding̈ƌ 0 Ŗ߂
+	if (write_zero(fpw, tag->bufsize - tag->paddingpos + shrink - cut)) return RET_ERROR;
+
+	return RET_OK;
+}
+
+
+/* write_id3_tag_inplace **********************
+   ̃^ÖƓTCYɂȂ悤A
+   padding̈ɉ񂵂^Öo
+   񓯊ꂽ^O͉܂܏o
+   (Ōbytepadding̈ɉ)
+
+   ߂lF(F0@sF-1)
+***********************************************/
+int write_id3_tag_inplace(FILE *fpw, const ID3TAG *tag, unsigned int headersize, const ID3JOB *job) {
+	return write_id3_tag_cut(fpw, tag, headersize, 0, job);
+}
+
+
+/* repair_id3_tag *****************************
+   id3^OC
+   ^O̓̃t[ꗗ珑oA
+   pfBOȍ~̃f[^̈fprRs[
+
+   ߂lF(F0@sF-1)
+   ӁFOget_id3_repair_sizes
+         headersize擾ĂKv
+***********************************************/
+int repair_id3_tag(FILE *fpw, FILE *fpr, const ID3TAG *tag, unsigned int headersize, const ID3JOB *job) {
+	int ret;
+
+	// ^O
+	start_id3_stats(job->stats, STATS_TAG);
+	ret = write_id3_tag(fpw, tag, headersize, job);
+	stop_id3_stats(job->stats, STATS_TAG);
+	if (ret) return RET_ERROR;
+
+	// f[^̈Rs[
+	start_id3_stats(job->stats, STATS_COPY);
+	if (job->stats != NULL) job->stats->seeks++;
+	ret = (fseeko(fpr, tag->tagsize, SEEK_SET) || fcopy(fpw, fpr, job->stats)) ? RET_ERROR : RET_OK;
+	stop_id3_stats(job->stats, STATS_COPY);
+	
+	return ret;
+}
+
+
+/* repair_id3_tag_inplace *********************
+   id3^Ot@CŒڏC
+   ^O͏ȂȂ̂ŁApadding̈
+   񂹂΃^OTCY͕ς炸Af[^͈̈ړȂ
+
+   fp: "r+b"ŊJCΏۃt@C
+   ߂lF(F0@sF-1)
+   ӁFOget_id3_repair_sizes
+         headersize擾ĂKv
+         .bak͍쐬Ȃ߁Aݒɒf
+         ^O
+***********************************************/
+int repair_id3_tag_inplace(FILE *fp, const ID3TAG *tag, unsigned int headersize, const ID3JOB *job) {
+	int ret = RET_ERROR;
+
+	start_id3_stats(job->stats, STATS_TAG);
+	if (job->stats != NULL) job->stats->seeks++;
+	if (fseeko(fp, 0, SEEK_SET)) goto REPAIR_ID3_TAG_INPLACE_EXIT;
+
+	if (write_id3_tag_inplace(fp, tag, headersize, job)) goto REPAIR_ID3_TAG_INPLACE_EXIT;
+
+	// ^Ö͂ݏoĂȂmF
+	if (fflush(fp)) goto REPAIR_ID3_TAG_INPLACE_EXIT;
+	if (ftello(fp) != tag->tagsize) {
+		fprintf(stderr, "in-place repair overran the tag region.\n");
+		goto REPAIR_ID3_TAG_INPLACE_EXIT;
+	}
+	if (fsync(fileno(fp))) goto REPAIR_ID3_TAG_INPLACE_EXIT;
+	ret = RET_OK;
+
+  REPAIR_ID3_TAG_INPLACE_EXIT:
+	stop_id3_stats(job->stats, STATS_TAG);
+	return ret;
+}
+
+
+/* repair_id3_tag_collapse ********************
+   id3^Ot@CŒڏCÂ
+   t@CVXẽubNPʂ̕
+   fallocate(FALLOC_FL_COLLAPSE_RANGE)Ńt@C擪菜
+   f[^̈̓Rs[A[padding̈ɉ
+   (񓯊͉܂܏o)
+
+   fp: "r+b"ŊJCΏۃt@C
+   ߂lF0 G[-1
+           菜Ȃ(ubNɖȂAFSΉ)ꍇ
+           t@CύX1
+   ӁFOget_id3_repair_sizes
+         headersize擾ĂKv
+         菜Ă^Oނ̂ŁÅԂɒf
+         ^O
+***********************************************/
+int repair_id3_tag_collapse(FILE *fp, const ID3TAG *tag, unsigned int headersize, const ID3JOB *job) {
+	const ID3OPTION *option = job->option;
+	struct stat st;
+	unsigned int size, cut, extra;
+	int ret = RET_ERROR;
+
+	// -iȊOł͒ʏ̏oƓeɂȂꍇɌ
+	// (񓯊Apadding̎wɍȂ)
+	size = ID3_HEADER_SIZE + headersize;
+	if (size > tag->tagsize) return RET_FAILURE;
+	if (! (option->flag & OPTFLAG_INPLACE) && (tag->header.flag & FLAG_SYN)
+		&& ! (option->flag & OPTFLAG_NOUNSYNC)) return RET_FAILURE;
+
+	// 菜̂̓ubNP (f[^̈܂œ͂Ȃ)
+	if (fstat(fileno(fp), &st) || (st.st_blksize <= 0)) return RET_FAILURE;
+	cut = (tag->tagsize - size) / st.st_blksize * st.st_blksize;
+	if ((cut == 0) || ((off_t)cut >= st.st_size)) return RET_FAILURE;
+	extra = tag->tagsize - cut - size;
+	if (! (option->flag & OPTFLAG_INPLACE)) {
+		if ((option->flag & OPTFLAG_PADDING) && (extra != 0)) return RET_FAILURE;
+		if ((option->flag & OPTFLAG_MAXPADDING) && (tag->padding + extra > option->maxpadding)) return RET_FAILURE;
+	}
+
+	// s΃t@C͕ςĂȂ̂ŁAĂяoŃRs[
+	start_id3_stats(job->stats, STATS_COPY);
+	if (fflush(fp) || fallocate(fileno(fp), FALLOC_FL_COLLAPSE_RANGE, 0, cut)) {
+		stop_id3_stats(job->stats, STATS_COPY);
+		if (option->flag & OPTFLAG_VERBOSE) fprintf(job->log, "%s : collapse failed (%s)\n", job->filename, strerror(errno));
+		return RET_FAILURE;
+	}
+	stop_id3_stats(job->stats, STATS_COPY);
+	if (option->flag & OPTFLAG_VERBOSE) {
+		fprintf(job->log, "%s : collapse %u bytes (padding +%u)\n", job->filename, cut, extra);
+	}
+
+	start_id3_stats(job->stats, STATS_TAG);
+	if (job->stats != NULL) job->stats->seeks++;
+	if (fseeko(fp, 0, SEEK_SET)) goto REPAIR_ID3_TAG_COLLAPSE_EXIT;
+
+	if (write_id3_tag_cut(fp, tag, headersize, cut, job)) goto REPAIR_ID3_TAG_COLLAPSE_EXIT;
+
+	// 菜̃^ÖɎ܂mF
+	if (fflush(fp)) goto REPAIR_ID3_TAG_COLLAPSE_EXIT;
+	if (ftello(fp) != tag->tagsize - cut) {
+		fprintf(stderr, "collapse repair overran the tag region.\n");
+		goto REPAIR_ID3_TAG_COLLAPSE_EXIT;
+	}
+	if (fsync(fileno(fp))) goto REPAIR_ID3_TAG_COLLAPSE_EXIT;
+	ret = RET_OK;
+
+  REPAIR_ID3_TAG_COLLAPSE_EXIT:
+	stop_id3_stats(job->stats, STATS_TAG);
+	return ret;
+}
+
+
+/* repair_id3_stream ******************
+   open_id3_reader_streamœǂ񂾃^OCfpwɏoA
+   f[^̈fdr炻̂܂܃Rs[
+   headersize0łΌ̃^Ö̂܂܏o
+   (seekȂ̂ŁAfpw,fdr̓pCvł悢)
+
+   ߂lF(F0@sF-1)
+****************************************/
+int repair_id3_stream(FILE *fpw, int fdr, const ID3TAG *tag, unsigned int headersize, const ID3JOB *job) {
+	int ret;
+
+	// ^O
+	start_id3_stats(job->stats, STATS_TAG);
+	if (0 == headersize) ret = (tag->tagsize == fwrite(tag->reader.base, 1, tag->tagsize, fpw)) ? RET_OK : RET_ERROR;
+	else if (job->option->flag & OPTFLAG_INPLACE) ret = write_id3_tag_inplace(fpw, tag, headersize, job);
+	else ret = write_id3_tag(fpw, tag, headersize, job);
+	stop_id3_stats(job->stats, STATS_TAG);
+	if (ret) return RET_ERROR;
+
+	// f[^͓̈ǂݍ܂Ɏ󂯓n
+	start_id3_stats(job->stats, STATS_COPY);
+	ret = fdcopy(fpw, fdr, job->stats);
+	stop_id3_stats(job->stats, STATS_COPY);
+
+	return ret;
+}
+
+
+/* repair_id3_buffer ********************
+   ̃^OC (t@Cɂ͈ؐGȂ)
+   buf: t@C擪班ȂƂ^ÖS
+        (ɉf[^ĂĂ悢BύXȂ)
+   result->tagɏC̃^ÖmallocĕԂ
+   C̃t@C result->tag + (buf + result->oldsize ȍ~) ƂȂ
+   Csvłresult->tagNULL
+   O[oȏԂ͎Ȃ̂ŁAresultʂł
+   ̃Xbh瓯ɌĂׂ (option͋LĂ悢)
+
+   ߂lFCsv0 C1 G[-1
+****************************************/
+int repair_id3_buffer(const unsigned char *buf, size_t size, const ID3OPTION *option, ID3RESULT *result) {
+	ID3TAG tag;
+	ID3JOB job;
+	FILE *fp;
+	char *out = NULL;
+	size_t outsize = 0;
+	unsigned int headersize;
+	int ret;
+
+	memset(result, 0, sizeof(*result));
+	memset(&tag, 0, sizeof(tag));
+	memset(&job, 0, sizeof(job));
+	job.option = option;
+	job.log = stderr;
+	strncpy(job.filename, BUFFER_NAME, FILENAME_MAX - 1);
+
+	open_id3_reader_mem(&(tag.reader), buf, size);
+	if (parse_id3_tag(&tag)) return RET_ERROR;
+	headersize = get_id3_repair_size(&tag, option);
+	if (RET_ERROR == headersize) goto REPAIR_ID3_BUFFER_ERROR;
+	result->oldsize = tag.tagsize;
+	result->report = tag.report;
+	if (0 == headersize) {
+		free_id3_tag(&tag);
+		return RET_OK;
+	}
+
+	// C̃^Öɍ
+	fp = open_memstream(&out, &outsize);
+	if (fp == NULL) goto REPAIR_ID3_BUFFER_ERROR;
+	ret = (option->flag & OPTFLAG_INPLACE)
+		? write_id3_tag_inplace(fp, &tag, headersize, &job)
+		: write_id3_tag(fp, &tag, headersize, &job);
+	if (fclose(fp) || ret) {
+		free(out);
+		goto REPAIR_ID3_BUFFER_ERROR;
+	}
+	result->tag = (unsigned char *)out;
+	result->size = outsize;
+
+	free_id3_tag(&tag);
+	return RET_FAILURE;
+
+  REPAIR_ID3_BUFFER_ERROR:
+	free_id3_tag(&tag);
+	memset(result, 0, sizeof(*result));
+	return RET_ERROR;
+}
+
+
+/* free_id3_result **********************
+   repair_id3_buffeřʂ
+****************************************/
+void free_id3_result(ID3RESULT *result) {
+	free(result->tag);
+	memset(result, 0, sizeof(*result));
+}
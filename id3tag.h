@@ -0,0 +1,387 @@
+/*
+  F
+    ID3v2.3^O̓ǂݍ݁ÉEo
+    libid3repair.a ̌Jwb_ŁAR}h(id3_tag_repair.c)
+    x`}[N(bench/)g
+    Erepair_id3_buffer̓̃^OŏC (t@CgȂ)
+    EreaderŃ^ÖQƂAt[ꗗ쐬
+    Eget_id3_repair_sizeŊet[̏肷
+    Ewrite_id3_tag / repair_id3_tag ŏC^Oo
+
+  Ql :
+     http://www.takaaki.info/id3/ID3v2.3.0J.html
+
+  쐬ҁ@@Fgbm
+*/
+#ifndef ID3TAG_H
+#define ID3TAG_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "scan.h"
+#include "stats.h"
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+//#define DEBUG_ON
+//#define DEBUG2_ON
+
+#define RET_OK 0
+#define RET_ERROR -1
+#define RET_FAILURE 1
+#define RET_REPETITION 1
+
+#define FOUR_BYTE 0x04
+
+#define MIMETYPE_MAXSIZE 64
+
+#define ID3_HEADER_SIZE 10
+#define ID3_TAG_MAXSIZE 0x0FFFFFFF // synchsafe 28bit
+#define ID3_HEADER_ID_CHECK "ID3"
+#define ID3_HEADER_VERSION_CHECK 0x03
+#define ID3_HEADER_ID_SIZE 3
+#define ID3_FRAME_ID_PIC "APIC"
+#define ID3_FRAME_ID_SIZE 4
+#define ID3_FRAME_SIZE 10
+
+// t[IDbig endian32bitƂĔׂ
+#define ID3_FOURCC(p)								\
+	(												\
+		  ((unsigned int)(unsigned char)(p)[0] << 24)	\
+		| ((unsigned int)(unsigned char)(p)[1] << 16)	\
+		| ((unsigned int)(unsigned char)(p)[2] << 8)	\
+		|  (unsigned int)(unsigned char)(p)[3]			\
+	)
+#define FOURCC_APIC 0x41504943 // "APIC"
+
+#define TAG_READ_SIZE (64 * 1024) // ^Oǂ݃TCY
+
+#define OPTFLAG_REPETITION 0x01 // optflag
+#define OPTFLAG_DELETE 0x02     // optflag
+#define OPTFLAG_VERBOSE 0x04    // optflag
+#define OPTFLAG_INPLACE 0x08    // optflag
+#define OPTFLAG_CHECK 0x10      // optflag
+#define OPTFLAG_DEDUP 0x20      // optflag
+#define OPTFLAG_PADDING 0x40    // optflag
+#define OPTFLAG_MAXPADDING 0x80 // optflag
+#define OPTFLAG_NOUNSYNC 0x100  // optflag
+#define OPTFLAG_MAXAPIC 0x200   // optflag
+#define OPTFLAG_COLLAPSE 0x400  // optflag
+
+#define RULE_MAX 64             // opt [-d] [--rules] Ŏwłt[ID
+
+#define KEEP_FIRST 0            // dAPIC̓^Oōŏ̕c
+#define KEEP_LARGEST 1          // dAPIC̓t[ő̕c
+#define KEEP_SMALLEST 2         // dAPIC̓t[ŏ̕c
+
+#define HASH_PRIME1 0x9E3779B97F4A7C15ULL
+#define HASH_PRIME2 0xC2B2AE3D27D4EB4FULL
+
+#define APICTYPE_NUM 0x15
+
+#define REVERSE_ENDIAN(n)				\
+	(									\
+		  ((n & 0xFF000000) >> 24)		\
+		| ((n & 0x00FF0000) >> 8)		\
+		| ((n & 0x0000FF00) << 8)		\
+		| ((n & 0x000000FF) << 24)		\
+	)
+
+// SYNCHSAFEϊnv2.3^Oł͗pȂ(v2.4only)
+// v2.3łwb_TCŶݓ`ŕۑ
+// ENDIANϊ
+#define FROM_SYNCHSAFE(n)			\
+	(								\
+     	  ((n & 0x7F000000) >> 24)	\
+     	+ ((n & 0x007F0000) >> 9)	\
+     	+ ((n & 0x00007F00) << 6)	\
+		+ ((n & 0x0000007F) << 21)	\
+	)
+
+#define TO_SYNCHSAFE(n)				\
+	(								\
+     	  ((n & 0x0FE00000) >> 21)	\
+     	+ ((n & 0x001FC000) >> 6)	\
+     	+ ((n & 0x00003F80) << 9)	\
+		+ ((n & 0x0000007F) << 24)	\
+	)
+
+
+
+/****************************************************/
+/*                      struct                      */
+/****************************************************/
+
+/* ID3header *************************
+   
+     ID3v2/t@Cʎq      "ID3"
+     ID3v2 o[W          $03 00
+     ID3v2 tO              %abcd0000
+     ID3v2 TCY          4 * %0xxxxxxx
+
+  *ID3v2^OTCY͊gwb_APadding̈ASẴt[̃oCgi
+   [ĂBtb^݂ĂꍇA̒l('S' - 20)oCgA
+   łȂ('S' - 10)oCgɓB
+
+**************************************/
+typedef struct id3header{
+	char id3[ID3_HEADER_ID_SIZE];
+	unsigned char version[2];
+	unsigned char flag;
+	unsigned int size;
+}ID3HEADER;
+
+#define FLAG_SYN 0x80
+#define FLAG_EXT 0x40
+#define FLAG_EXP 0x20
+//#define FLAG_FTR 0x10 v2.4
+
+
+/* ID3extheader **************************
+   gwb_TCY $xx xx xx xx
+   gtO $xx xx
+   Padding̈̃TCY $xx xx xx xx
+******************************************/
+typedef struct id3extheader{
+	unsigned int size;
+	unsigned char flag[2];
+	unsigned int padding_size;
+	unsigned char crc[4];
+} ID3EXTHEADER;
+
+#define EXT_FLAG_CRC 0x80
+
+
+/* ID3frameheader **************************
+     t[ ID      $xx xx xx xx  (S)
+     TCY       4 * %0xxxxxxx
+     tO           $xx xx
+******************************************/
+typedef struct id3frameheader{
+	char id[ID3_FRAME_ID_SIZE];
+	unsigned int size;
+	unsigned char flag[2];
+}ID3FRAMEHEADER;
+
+// flag[1] Ă΃f[^̐擪ɂ̏Œǉbyte
+#define FRAME_FLAG_COMP 0x80    // WJ̃TCY $xx xx xx xx (ȍ~zlib)
+#define FRAME_FLAG_ENC 0x40     // Í $xx
+#define FRAME_FLAG_GROUP 0x20   // O[vID $xx
+
+
+/* ID3APICframe **************************
+   Text encoding $xx
+   MIME type <text string> $00
+   Picture type $xx
+   Description <text string according to encoding> $00 (00)
+   Picture data <binary data>
+******************************************/
+typedef struct id3apicframe{
+	unsigned char encode;
+	char mimetype[MIMETYPE_MAXSIZE];
+	unsigned char pictype;
+	unsigned char description;
+	unsigned char *data;
+	
+}ID3APICFRAME;
+
+#define PICTURE_TYPE_NUM 0x15
+
+
+/* ID3frame ******************************
+   ^Oobt@̃t[ʒuƁA
+   get_id3_repair_sizeŌ肵
+******************************************/
+typedef struct id3frame{
+	ID3FRAMEHEADER header;
+	unsigned int pos;       // ^O擪̃t[ʒu
+	unsigned int fourcc;    // ID3_FOURCC(header.id)
+	unsigned char rule;     // get_id3_rulě
+	unsigned char action;
+	unsigned char pictype;  // ȉ͏dAPIC̔p
+	unsigned int picpos;    // {̂ł̉摜f[^ʒu (0:s)
+	unsigned int picsize;
+	unsigned long long pichash;
+	unsigned char *unpacked;  // kt[̖{̂WJ (ǂޕKvꍇ̂)
+	unsigned int unpackedsize;
+	unsigned char *packed;    // C̃f[^ (ǉbytêt[̂)
+	unsigned int packedsize;
+}ID3FRAME;
+
+#define FRAME_KEEP 0
+#define FRAME_DELETE 1            // -d / --rules ō폜^Cv
+#define FRAME_DELETE_REPETITION 2 // -r / --dedup dAPIC
+#define FRAME_REPAIR_MIME 3       // ima ge -> image
+#define FRAME_DELETE_LARGE 4      // --max-apic-bytes 𒴂APIC
+
+
+/* ID3reader *****************************
+   ^Ö̓ǂݍ݌
+     READER_MMAP : t@Cmmapăy[WLbV𒼐ڎQƂ
+     READER_BUF  : preadŃobt@ɓǂݍ
+     READER_STREAM : pCvreadŕKvȕɓǂݍ (seekȂ)
+******************************************/
+typedef struct id3reader{
+	const unsigned char *base;  // t@C擪
+	size_t size;                // baseQƂłbyte
+	size_t pos;                 // ǂݍ݈ʒu
+	int type;
+	int fd;
+	unsigned char *buf;         // READER_BUF̃obt@
+}ID3READER;
+
+#define READER_BUF 0
+#define READER_MMAP 1
+#define READER_STREAM 2
+
+
+/* ID3report *****************************
+   get_id3_repair_sizeŌ肵Ce
+******************************************/
+typedef struct id3report{
+	unsigned int mime;         // ima ge -> image ̏C
+	unsigned int repetition;   // dAPIC̍폜 (-r / --dedup)
+	unsigned int del;          // -d / --rules ɂ폜
+	unsigned int large;        // --max-apic-bytes ɂ폜
+	unsigned int saved;        // 팸byte
+}ID3REPORT;
+
+
+/* ID3tag ********************************
+   readerŎQƂ^Öƃt[ꗗ
+******************************************/
+typedef struct id3tag{
+	ID3HEADER header;
+	ID3EXTHEADER extheader;
+	ID3READER reader;
+	const unsigned char *buf; // ͂^Ö (񓯊ĂΉ)
+	unsigned int bufsize;
+	unsigned int tagsize;     // t@C̃^Ö (ID3_HEADER_SIZE + header.size byte)
+	unsigned char *syncbuf;   // 񓯊^Ö (bufw)
+	unsigned int datapos;     // ŏ̃t[ʒu
+	unsigned int paddingpos;  // padding̈̊Jnʒu
+	unsigned int padding;     // ^Opadding byte (get_id3_repair_sizeŌ߂)
+	ID3FRAME *frame;
+	int framenum;
+	int framemax;
+	ID3SCAN scan;              // ^Ö̑
+	ID3REPORT report;
+	ID3STATS *stats;           // vȂNULL (read_id3_tagɐݒ肷)
+}ID3TAG;
+
+/* ID3rule *******************************
+   t[ID̏
+     RULE_KEEP   : ̂܂܎c
+     RULE_DELETE : 폜
+     RULE_PATCH  : C (APICMIMETYPECEd폜̑Ώ)
+   w̖IDAPICȂRULE_PATCHAȊORULE_KEEP
+******************************************/
+typedef struct id3rule{
+	unsigned int fourcc;
+	unsigned char action;
+}ID3RULE;
+
+#define RULE_KEEP 0
+#define RULE_DELETE 1
+#define RULE_PATCH 2
+
+
+/* ID3option *****************************
+   R}hCŎw肳ꂽe
+   (SWuŋLAύXȂ)
+******************************************/
+typedef struct id3option{
+	unsigned int flag;         // OPTFLAG_DELETEruleRULE_DELETE
+	ID3RULE rule[RULE_MAX];    // fourcc̏ (add_id3_ruleŒǉ)
+	int rulenum;
+	unsigned char stats;       // STATS_OFF / STATS_TEXT / STATS_JSON
+	unsigned char keep;        // KEEP_FIRST / KEEP_LARGEST / KEEP_SMALLEST
+	unsigned int padding;      // opt [--padding] ^Opadding byte
+	unsigned int maxpadding;   // opt [--max-padding] padding̏
+	unsigned int maxapic;      // opt [--max-apic-bytes] APICt[(wb_)̏
+}ID3OPTION;
+
+
+struct id3cache; // cache.h
+struct id3journal; // journal.h
+
+/* ID3job ********************************
+   t@C1̏
+******************************************/
+typedef struct id3job{
+	const ID3OPTION *option;
+	char filename[FILENAME_MAX];
+	FILE *log;                 // verboseo͐
+	ID3STATS *stats;           // vȂNULL
+	ID3STATS *total;           // stats̏Wv
+	struct id3cache *cache;    // opt [--cache] łȂNULL
+	struct id3journal *journal;  // opt [--journal] łȂNULL
+}ID3JOB;
+
+#define ID3_FRAME_DATA(tag, frame) ((tag)->buf + (frame)->pos + ID3_FRAME_SIZE)
+
+
+/* ID3result *****************************
+   repair_id3_buffeř
+******************************************/
+typedef struct id3result{
+	unsigned char *tag;        // C̃^Ö (mallocACsvȂNULL)
+	size_t size;               // tagbyte
+	size_t oldsize;            // ̃^Öbyte (̌낪f[^)
+	ID3REPORT report;
+}ID3RESULT;
+
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+int fcopy(FILE *fpw, FILE *fpr, ID3STATS *stats);
+int fncopy(FILE *fpw, FILE *fpr, off_t n, ID3STATS *stats);
+int fdcopy(FILE *fpw, int fdr, ID3STATS *stats);
+
+int open_id3_reader(ID3READER *rd, int fd, int type);
+int open_id3_reader_buf(ID3READER *rd, unsigned char *buf, size_t size);
+int open_id3_reader_mem(ID3READER *rd, const unsigned char *buf, size_t size);
+int open_id3_reader_stream(ID3READER *rd, int fd);
+void close_id3_reader(ID3READER *rd);
+int fetch_id3_reader(ID3READER *rd, size_t n);
+
+int read_id3_header(ID3HEADER *header, ID3READER *rd);
+int read_id3_extheader(ID3EXTHEADER *header, ID3READER *rd);
+int read_id3_frame_header(ID3FRAMEHEADER *header, ID3READER *rd);
+
+int write_id3_header(const ID3HEADER *header, FILE *fp);
+int write_id3_extheader(const ID3EXTHEADER *header, FILE *fp);
+int write_id3_frame(const ID3FRAMEHEADER *header, const unsigned char *data, FILE *fpw);
+int write_id3_repair_apic_frame(const ID3FRAMEHEADER *header, const unsigned char *data, FILE *fpw);
+
+int get_id3_apic_type(const unsigned char *data, unsigned int size, unsigned char *apictype);
+int get_id3_apic_picture(const unsigned char *data, unsigned int size, unsigned int *pos);
+unsigned long long hash_id3_data(const void *data, size_t size, unsigned long long seed);
+
+int check_id3_mime_type(const unsigned char *data, unsigned int size);
+int add_id3_rule(ID3OPTION *option, const char *id, int action);
+int get_id3_rule(const ID3OPTION *option, unsigned int fourcc);
+int check_id3_tag(const ID3HEADER *header);
+int read_id3_tag(ID3TAG *tag, int fd, int type);
+int parse_id3_tag(ID3TAG *tag);
+int walk_id3_tag(ID3TAG *tag);
+int check_id3_scan(const ID3TAG *tag, const ID3OPTION *option);
+void free_id3_tag(ID3TAG *tag);
+int move_id3_tag(ID3TAG *tag, int fd);
+unsigned int get_id3_repair_size(ID3TAG *tag, const ID3OPTION *option);
+int check_id3_apic_duplicate(ID3TAG *tag, const ID3OPTION *option);
+int write_id3_frames(FILE *fpw, const ID3TAG *tag, const ID3JOB *job, unsigned int *crc);
+int write_zero(FILE *fpw, size_t n);
+int write_id3_tag(FILE *fpw, const ID3TAG *tag, unsigned int headersize, const ID3JOB *job);
+int write_id3_tag_inplace(FILE *fpw, const ID3TAG *tag, unsigned int headersize, const ID3JOB *job);
+int repair_id3_tag(FILE *fpw, FILE *fpr, const ID3TAG *tag, unsigned int headersize, const ID3JOB *job);
+int repair_id3_tag_inplace(FILE *fp, const ID3TAG *tag, unsigned int headersize, const ID3JOB *job);
+int repair_id3_tag_collapse(FILE *fp, const ID3TAG *tag, unsigned int headersize, const ID3JOB *job);
+int repair_id3_stream(FILE *fpw, int fdr, const ID3TAG *tag, unsigned int headersize, const ID3JOB *job);
+
+int repair_id3_buffer(const unsigned char *buf, size_t size, const ID3OPTION *option, ID3RESULT *result);
+void free_id3_result(ID3RESULT *result);
+
+#endif
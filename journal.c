@@ -0,0 +1,684 @@
+/*
+  F
+    opt [--journal FILE] ̃ob`̋L^
+    Et@C͉ϒrecord̕тŁA1O_APPEND1writevŒǋL
+    Eǂݍݎmagicsum̍Ȃrecord͎̂ĂĐ؂l߂
+    Epath͌̋L^قǐV (ADD  BEGIN  ENDAwatchł͌JԂ)
+    ESďIĕ΋L^͕svȂ̂ō폜
+
+  쐬ҁ@@Fgbm
+*/
+
+
+/****************************************************/
+/*                     include                      */
+/****************************************************/
+#define _GNU_SOURCE // fallocate
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h> // offsetof
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h> // writev
+#include "journal.h"
+#include "cache.h"
+
+
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+#define JOURNAL_MAGIC 0x4A334449      // "ID3J"
+#define JOURNAL_VERSION 1             // record̈Ӗςグ
+#define JOURNAL_TABLE_MIN 1024
+#define JOURNAL_READ_SIZE (1024 * 1024)  // ǂݍ݃obt@̏TCY
+#define JOURNAL_SYNC_NUM 1024         // ENĎfsync
+#define JOURNAL_SYNC_SEC 1.0          // Ofsync炱̕boĂfsync
+#define JOURNAL_BAK_SUFFIX ".bak"
+
+#define JOURNAL_HEAD 'H'
+#define JOURNAL_ADD 'A'
+#define JOURNAL_SCAN 'S'
+#define JOURNAL_BEGIN 'B'
+#define JOURNAL_END 'E'
+
+#define JOURNAL_MTIME(st) ((unsigned long long)(st)->st_mtim.tv_sec * 1000000000ULL + (st)->st_mtim.tv_nsec)
+
+
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+static double get_journal_time(void);
+static unsigned long long sum_id3_journal(const ID3JOURNALREC *rec, const char *path, const unsigned char *tag);
+static ID3JOURNALFILE *find_id3_journal(ID3JOURNAL *j, const char *path, size_t len, int create);
+static int grow_id3_journal(ID3JOURNAL *j, size_t tablesize);
+static void set_id3_journal_state(ID3JOURNAL *j, ID3JOURNALFILE *f, int state);
+static int write_id3_journal(ID3JOURNAL *j, ID3JOURNALREC *rec, const char *path, const unsigned char *tag);
+static int apply_id3_journal(ID3JOURNAL *j, const ID3JOURNALREC *rec, const unsigned char *data);
+static int load_id3_journal(ID3JOURNAL *j);
+static int recover_id3_journal(ID3JOURNAL *j);
+static int restore_id3_backup(const ID3JOURNALFILE *f);
+static int restore_id3_tag(const ID3JOURNALFILE *f);
+
+
+
+/****************************************************/
+/*                    Process                       */
+/****************************************************/
+
+/* get_id3_journal_key ******************
+   ʂɉeoptionhash
+   (--cache̕ --check  --collapse )
+   optionႤs̋L^͍ĊJȂ
+****************************************/
+unsigned long long get_id3_journal_key(const ID3OPTION *option) {
+	unsigned int flag = option->flag & (OPTFLAG_CHECK | OPTFLAG_COLLAPSE);
+
+	return hash_id3_data(&flag, sizeof(flag), get_id3_cache_key(option) ^ JOURNAL_VERSION);
+}
+
+
+/* open_id3_journal *********************
+   path̋L^ǂݍ݁AǋLł悤ɊJ
+   ΍쐬
+   OBEGIN̂܂܏IȂt@C͏Oɖ߂
+   ߂lF(F0@sF-1)
+****************************************/
+int open_id3_journal(ID3JOURNAL *j, const char *path, unsigned long long optkey) {
+	ID3JOURNALREC rec;
+	size_t i;
+
+	memset(j, 0, sizeof(*j));
+	j->fd = -1;
+	if (strlen(path) >= FILENAME_MAX) return RET_ERROR;
+	strncpy(j->path, path, FILENAME_MAX - 1);
+
+	if (grow_id3_journal(j, JOURNAL_TABLE_MIN)) return RET_ERROR;
+	pthread_mutex_init(&(j->lock), NULL);
+
+	j->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+	if (j->fd < 0) goto OPEN_ID3_JOURNAL_ERROR;
+	if (load_id3_journal(j)) goto OPEN_ID3_JOURNAL_ERROR;
+
+	// VL^łoptionĂ
+	if (j->size == 0) {
+		memset(&rec, 0, sizeof(rec));
+		rec.type = JOURNAL_HEAD;
+		rec.optkey = optkey;
+		if (write_id3_journal(j, &rec, NULL, NULL)) goto OPEN_ID3_JOURNAL_ERROR;
+		j->optkey = optkey;
+	}
+	if (j->optkey != optkey) {
+		fprintf(stderr, "journal %s was written with other options.\n", path);
+		goto OPEN_ID3_JOURNAL_ERROR;
+	}
+
+	if (recover_id3_journal(j)) goto OPEN_ID3_JOURNAL_ERROR;
+	j->resume = j->num;
+	for (i = 0; i < j->num; i++) j->file[i].old = 1;
+	j->synctime = get_journal_time();
+
+	return RET_OK;
+
+  OPEN_ID3_JOURNAL_ERROR:
+	close_id3_journal(j);
+	return RET_ERROR;
+}
+
+
+/* next_id3_journal *********************
+   O̎sŏIȂt@CL^ɕԂ
+   i: 0n߁AĂԓxɐi߂
+   ߂lFpath NULL
+****************************************/
+const char *next_id3_journal(ID3JOURNAL *j, size_t *i) {
+	const char *path = NULL;
+
+	pthread_mutex_lock(&(j->lock));
+	for (; *i < j->resume; (*i)++) {
+		if (j->file[*i].state == JOURNAL_END) continue;
+		path = j->file[*i].path;
+		(*i)++;
+		break;
+	}
+	pthread_mutex_unlock(&(j->lock));
+
+	return path;
+}
+
+
+/* add_id3_journal **********************
+   pathς񂾂ƂL^
+   O̎sppath́A̗񋓂I܂ł
+   (IĂ邩Anext_id3_journalŐςݒĂ̂)L^Ȃ
+   ߂lFς1 ς܂Ȃ0 G[-1
+****************************************/
+int add_id3_journal(ID3JOURNAL *j, const char *path) {
+	ID3JOURNALREC rec;
+	ID3JOURNALFILE *f;
+	int ret = 1;
+
+	pthread_mutex_lock(&(j->lock));
+	f = find_id3_journal(j, path, strlen(path), 1);
+	if (f == NULL) ret = RET_ERROR;
+	else if (f->old && ! j->scandone) ret = 0;
+	else {
+		memset(&rec, 0, sizeof(rec));
+		rec.type = JOURNAL_ADD;
+		if (write_id3_journal(j, &rec, path, NULL)) ret = RET_ERROR;
+		else set_id3_journal_state(j, f, JOURNAL_ADD);
+	}
+	if (f != NULL) f->old = 0;
+	pthread_mutex_unlock(&(j->lock));
+
+	return ret;
+}
+
+
+/* scan_id3_journal *********************
+   ̗񋓂IƂL^
+   (̓t@C񋓂ɋL^ĊJ)
+   ߂lF(F0@sF-1)
+****************************************/
+int scan_id3_journal(ID3JOURNAL *j) {
+	ID3JOURNALREC rec;
+	int ret;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.type = JOURNAL_SCAN;
+	pthread_mutex_lock(&(j->lock));
+	ret = write_id3_journal(j, &rec, NULL, NULL);
+	if (ret == RET_OK) j->scandone = 1;
+	pthread_mutex_unlock(&(j->lock));
+
+	return ret;
+}
+
+
+/* begin_id3_journal ********************
+   pathn߂邱ƂL^AfsyncĂ߂
+   st: Õt@C
+   tag: JOURNAL_INPLACEłΌ̃^Ö (ȊONULL)
+   ߂lF(F0@sF-1)
+****************************************/
+int begin_id3_journal(ID3JOURNAL *j, const char *path, int method, const struct stat *st, const unsigned char *tag, size_t taglen) {
+	ID3JOURNALREC rec;
+	ID3JOURNALFILE *f;
+	int ret = RET_ERROR;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.type = JOURNAL_BEGIN;
+	rec.method = method;
+	rec.dev = st->st_dev;
+	rec.ino = st->st_ino;
+	rec.size = st->st_size;
+	rec.mtime = JOURNAL_MTIME(st);
+	if (tag != NULL) rec.taglen = taglen;
+
+	pthread_mutex_lock(&(j->lock));
+	f = find_id3_journal(j, path, strlen(path), 1);
+	if ((f != NULL) && (RET_OK == write_id3_journal(j, &rec, path, tag))) {
+		set_id3_journal_state(j, f, JOURNAL_BEGIN);
+		ret = RET_OK;
+	}
+	pthread_mutex_unlock(&(j->lock));
+
+	// fsyncĂȂENDŏ܂
+	if ((ret == RET_OK) && fdatasync(j->fd)) ret = RET_ERROR;
+
+	return ret;
+}
+
+
+/* end_id3_journal **********************
+   pathIƂL^
+   JOURNAL_SYNC_NUMAJOURNAL_SYNC_SECbfsync
+   (fsyncĂȂ͎x)
+   result:  (process_id3_file̖߂l)
+   ߂lF(F0@sF-1)
+****************************************/
+int end_id3_journal(ID3JOURNAL *j, const char *path, int result) {
+	ID3JOURNALREC rec;
+	ID3JOURNALFILE *f;
+	double now;
+	int sync = 0, ret = RET_ERROR;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.type = JOURNAL_END;
+	rec.method = result;
+
+	pthread_mutex_lock(&(j->lock));
+	f = find_id3_journal(j, path, strlen(path), 1);
+	if ((f != NULL) && (RET_OK == write_id3_journal(j, &rec, path, NULL))) {
+		set_id3_journal_state(j, f, JOURNAL_END);
+		ret = RET_OK;
+		j->unsynced++;
+		now = get_journal_time();
+		if ((j->unsynced >= JOURNAL_SYNC_NUM) || (now - j->synctime >= JOURNAL_SYNC_SEC)) {
+			j->unsynced = 0;
+			j->synctime = now;
+			sync = 1;
+		}
+	}
+	pthread_mutex_unlock(&(j->lock));
+
+	// fsynclock̊OōsAworker̒ǋL҂Ȃ
+	if (sync && fdatasync(j->fd)) ret = RET_ERROR;
+
+	return ret;
+}
+
+
+/* close_id3_journal ********************
+   L^fsyncĕ
+   ̗񋓂IASẴt@CIĂ΋L^폜
+   ߂lF(F0@sF-1)
+****************************************/
+int close_id3_journal(ID3JOURNAL *j) {
+	size_t i;
+	int ret = RET_OK;
+
+	if (j->table == NULL) return RET_OK;
+	if (j->fd >= 0) {
+		if (fdatasync(j->fd)) ret = RET_ERROR;
+		if (close(j->fd)) ret = RET_ERROR;
+		if ((ret == RET_OK) && j->scandone && (j->left == 0) && unlink(j->path)) ret = RET_ERROR;
+	}
+
+	for (i = 0; i < j->num; i++) {
+		free(j->file[i].path);
+		free(j->file[i].begin);
+		free(j->file[i].tag);
+	}
+	free(j->file);
+	free(j->table);
+	j->table = NULL;
+	pthread_mutex_destroy(&(j->lock));
+
+	return ret;
+}
+
+
+/* open_id3_journal_dir *****************
+   patĥfBNgJ
+   (OύX쐬t@C̃GgfsyncŊm肳邽)
+   ߂lFfdAs-1
+****************************************/
+int open_id3_journal_dir(const char *path) {
+	char dir[FILENAME_MAX];
+	const char *p = strrchr(path, '/');
+	size_t len;
+
+	if (p == NULL) return open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	len = (p == path) ? 1 : (size_t)(p - path);
+	if (len >= FILENAME_MAX) return RET_ERROR;
+	memcpy(dir, path, len);
+	dir[len] = '\0';
+
+	return open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+
+/* get_journal_time *********************
+   ߂lFCLOCK_MONOTONIC̕b
+****************************************/
+static double get_journal_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* sum_id3_journal **********************
+   recorďŒ蒷(sum̎O܂)ApathA^Öhash
+****************************************/
+static unsigned long long sum_id3_journal(const ID3JOURNALREC *rec, const char *path, const unsigned char *tag) {
+	unsigned long long sum;
+
+	sum = hash_id3_data(rec, offsetof(ID3JOURNALREC, sum), JOURNAL_MAGIC);
+	if (rec->pathlen > 0) sum = hash_id3_data(path, rec->pathlen, sum);
+	if (rec->taglen > 0) sum = hash_id3_data(tag, rec->taglen, sum);
+
+	return sum;
+}
+
+
+/* find_id3_journal *********************
+   path(len byte)̋L^T
+   create: Βǉ
+   ߂lFL^ (ǉłȂ)NULL
+****************************************/
+static ID3JOURNALFILE *find_id3_journal(ID3JOURNAL *j, const char *path, size_t len, int create) {
+	ID3JOURNALFILE *f, *p;
+	unsigned long long hash = hash_id3_data(path, len, 0);
+	size_t mask = j->tablesize - 1;
+	size_t i = (hash >> 20) & mask;
+
+	for (; j->table[i] != 0; i = (i + 1) & mask) {
+		f = &(j->file[j->table[i] - 1]);
+		if ((f->hash == hash) && (0 == strncmp(f->path, path, len)) && (f->path[len] == '\0')) return f;
+	}
+	if (! create) return NULL;
+
+	// 𒴂e[uL
+	if ((j->num + 1) * 2 > j->tablesize) {
+		if (grow_id3_journal(j, j->tablesize * 2)) return NULL;
+		return find_id3_journal(j, path, len, create);
+	}
+	if (j->num >= j->filecap) {
+		p = realloc(j->file, sizeof(ID3JOURNALFILE) * (j->filecap ? j->filecap * 2 : JOURNAL_TABLE_MIN));
+		if (p == NULL) return NULL;
+		j->file = p;
+		j->filecap = j->filecap ? j->filecap * 2 : JOURNAL_TABLE_MIN;
+	}
+	f = &(j->file[j->num]);
+	memset(f, 0, sizeof(*f));
+	f->path = strndup(path, len);
+	if (f->path == NULL) return NULL;
+	f->hash = hash;
+	f->state = JOURNAL_END; // L^ĂȂ͏IĂ镨Ɠ
+	j->table[i] = ++(j->num);
+
+	return f;
+}
+
+
+/* grow_id3_journal *********************
+   e[utablesizeɍLAL^꒼
+   ߂lF(F0@sF-1)
+****************************************/
+static int grow_id3_journal(ID3JOURNAL *j, size_t tablesize) {
+	size_t *table;
+	size_t i, k, mask = tablesize - 1;
+
+	table = calloc(tablesize, sizeof(size_t));
+	if (table == NULL) return RET_ERROR;
+	for (i = 0; i < j->num; i++) {
+		for (k = (j->file[i].hash >> 20) & mask; table[k] != 0; k = (k + 1) & mask);
+		table[k] = i + 1;
+	}
+	free(j->table);
+	j->table = table;
+	j->tablesize = tablesize;
+
+	return RET_OK;
+}
+
+
+/* set_id3_journal_state ****************
+   f̏ԂςAIĂȂ𐔂
+****************************************/
+static void set_id3_journal_state(ID3JOURNAL *j, ID3JOURNALFILE *f, int state) {
+	if ((f->state == JOURNAL_END) && (state != JOURNAL_END)) j->left++;
+	if ((f->state != JOURNAL_END) && (state == JOURNAL_END)) j->left--;
+	f->state = state;
+	if (state != JOURNAL_BEGIN) {
+		free(f->begin);
+		free(f->tag);
+		f->begin = NULL;
+		f->tag = NULL;
+	}
+}
+
+
+/* write_id3_journal ********************
+   record1ǋL (magic,pathlen,sum͂Ŗ߂)
+   ȂΏ؂l߂
+   ߂lF(F0@sF-1)
+****************************************/
+static int write_id3_journal(ID3JOURNAL *j, ID3JOURNALREC *rec, const char *path, const unsigned char *tag) {
+	struct iovec iov[3];
+	ssize_t len, n;
+
+	rec->magic = JOURNAL_MAGIC;
+	rec->pathlen = (path != NULL) ? strlen(path) : 0;
+	if (tag == NULL) rec->taglen = 0;
+	rec->sum = sum_id3_journal(rec, path, tag);
+
+	iov[0].iov_base = rec;
+	iov[0].iov_len = sizeof(*rec);
+	iov[1].iov_base = (void *)path;
+	iov[1].iov_len = rec->pathlen;
+	iov[2].iov_base = (void *)tag;
+	iov[2].iov_len = rec->taglen;
+	len = sizeof(*rec) + rec->pathlen + rec->taglen;
+
+	do {
+		n = writev(j->fd, iov, 3);
+	} while ((n < 0) && (errno == EINTR));
+	if (n != len) {
+		if ((n > 0) && ftruncate(j->fd, j->size)) return RET_ERROR;
+		return RET_ERROR;
+	}
+	j->size += len;
+
+	return RET_OK;
+}
+
+
+/* apply_id3_journal ********************
+   ǂݍrecord 1L^̈ꗗɔf
+   data: Œ蒷ɑpathƃ^Ö
+   ߂lF(F0@sF-1)
+****************************************/
+static int apply_id3_journal(ID3JOURNAL *j, const ID3JOURNALREC *rec, const unsigned char *data) {
+	ID3JOURNALFILE *f;
+
+	if (rec->type == JOURNAL_HEAD) {
+		j->optkey = rec->optkey;
+		return RET_OK;
+	}
+	if (rec->type == JOURNAL_SCAN) {
+		j->scanned = 1;
+		return RET_OK;
+	}
+
+	f = find_id3_journal(j, (const char *)data, rec->pathlen, 1);
+	if (f == NULL) return RET_ERROR;
+	set_id3_journal_state(j, f, rec->type);
+	if (rec->type != JOURNAL_BEGIN) return RET_OK;
+
+	// ȌԂ͖߂܂ŎĂ
+	f->begin = malloc(sizeof(ID3JOURNALREC));
+	if (f->begin == NULL) return RET_ERROR;
+	*(f->begin) = *rec;
+	if (rec->taglen == 0) return RET_OK;
+	f->tag = malloc(rec->taglen);
+	if (f->tag == NULL) return RET_ERROR;
+	memcpy(f->tag, data + rec->pathlen, rec->taglen);
+
+	return RET_OK;
+}
+
+
+/* load_id3_journal *********************
+   L^擪ǂݍ
+   ꂽrecord()͎̂āAǋLʒuɑ
+   ߂lF(F0@sF-1)
+****************************************/
+static int load_id3_journal(ID3JOURNAL *j) {
+	ID3JOURNALREC rec;
+	unsigned char *buf, *p;
+	size_t bufsize = JOURNAL_READ_SIZE, have = 0, pos, need;
+	ssize_t n;
+	struct stat st;
+	int ret = RET_ERROR;
+
+	buf = malloc(bufsize);
+	if (buf == NULL) return RET_ERROR;
+
+	while (1) {
+		n = read(j->fd, buf + have, bufsize - have);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			goto LOAD_ID3_JOURNAL_EXIT;
+		}
+		have += n;
+
+		// Ărecord𔽉f
+		for (pos = 0, need = sizeof(rec); have - pos >= sizeof(rec); pos += need) {
+			memcpy(&rec, buf + pos, sizeof(rec));
+			if ((rec.magic != JOURNAL_MAGIC) || (rec.pathlen >= FILENAME_MAX)
+				|| (rec.taglen > ID3_HEADER_SIZE + ID3_TAG_MAXSIZE)) goto LOAD_ID3_JOURNAL_BROKEN;
+			if ((rec.type != JOURNAL_HEAD) && (rec.type != JOURNAL_ADD) && (rec.type != JOURNAL_SCAN)
+				&& (rec.type != JOURNAL_BEGIN) && (rec.type != JOURNAL_END)) goto LOAD_ID3_JOURNAL_BROKEN;
+			need = sizeof(rec) + rec.pathlen + rec.taglen;
+			if (have - pos < need) break;
+			p = buf + pos + sizeof(rec);
+			if (rec.sum != sum_id3_journal(&rec, (const char *)p, p + rec.pathlen)) goto LOAD_ID3_JOURNAL_BROKEN;
+			if ((rec.type != JOURNAL_HEAD) && (rec.type != JOURNAL_SCAN) && (rec.pathlen == 0)) goto LOAD_ID3_JOURNAL_BROKEN;
+			if (apply_id3_journal(j, &rec, p)) goto LOAD_ID3_JOURNAL_EXIT;
+			j->size += need;
+		}
+		memmove(buf, buf + pos, have - pos);
+		have -= pos;
+		if (n == 0) break;
+
+		// ^Ö܂record肫Ȃ΍L
+		if (need > bufsize) {
+			p = realloc(buf, need);
+			if (p == NULL) goto LOAD_ID3_JOURNAL_EXIT;
+			buf = p;
+			bufsize = need;
+		}
+	}
+
+  LOAD_ID3_JOURNAL_BROKEN:
+	// record؂l߁AǋLʒu𑵂
+	if (fstat(j->fd, &st)) goto LOAD_ID3_JOURNAL_EXIT;
+	if ((st.st_size > j->size) && ftruncate(j->fd, j->size)) goto LOAD_ID3_JOURNAL_EXIT;
+	ret = RET_OK;
+
+  LOAD_ID3_JOURNAL_EXIT:
+	free(buf);
+	return ret;
+}
+
+
+/* recover_id3_journal ******************
+   BEGIN̂܂܏IĂȂt@COɖ߂A
+   xςޕƂċL^
+   ߂Ȃt@C͐G炸ɏIƂ
+   ߂lF(F0@sF-1)
+****************************************/
+static int recover_id3_journal(ID3JOURNAL *j) {
+	ID3JOURNALREC rec;
+	ID3JOURNALFILE *f;
+	size_t i;
+	int res, found = 0;
+
+	for (i = 0; i < j->num; i++) {
+		f = &(j->file[i]);
+		if ((f->state != JOURNAL_BEGIN) || (f->begin == NULL)) continue;
+		found = 1;
+
+		res = (f->begin->method == JOURNAL_INPLACE) ? restore_id3_tag(f) : restore_id3_backup(f);
+		memset(&rec, 0, sizeof(rec));
+		if (res == RET_OK) {
+			rec.type = JOURNAL_ADD;
+		}
+		else {
+			fprintf(stderr, "journal : %s may be half written. It is left as it is.\n", f->path);
+			rec.type = JOURNAL_END;
+			rec.method = RET_ERROR;
+		}
+		if (write_id3_journal(j, &rec, f->path, NULL)) return RET_ERROR;
+		set_id3_journal_state(j, f, rec.type);
+	}
+
+	// ߂t@CɋL^Ȃ悤ɂ
+	if (found && fdatasync(j->fd)) return RET_ERROR;
+
+	return RET_OK;
+}
+
+
+/* restore_id3_backup *******************
+   JOURNAL_BACKUPŏn߂t@C߂
+   E.bakinodeł΁AOύX̌Ŏ~܂Ă
+   EinodeL^Ɠsize/mtimeł΁A܂ĂȂ
+   EinodeςĂ΁Areflink.bak珑Ɏ~܂Ă
+   ߂lF߂(߂Kv)0 ߂Ȃ-1
+****************************************/
+static int restore_id3_backup(const ID3JOURNALFILE *f) {
+	const ID3JOURNALREC *b = f->begin;
+	char bak[FILENAME_MAX];
+	struct stat st, bst;
+	int hasbak, fd, res;
+
+	if (FILENAME_MAX <= snprintf(bak, FILENAME_MAX, "%s%s", f->path, JOURNAL_BAK_SUFFIX)) return RET_ERROR;
+	hasbak = (0 == stat(bak, &bst));
+
+	if (hasbak && (bst.st_dev == b->dev) && (bst.st_ino == b->ino)) goto RESTORE_ID3_BACKUP_RENAME;
+	if (stat(f->path, &st) || (st.st_dev != b->dev) || (st.st_ino != b->ino)) return RET_ERROR;
+	if (((unsigned long long)st.st_size == b->size) && (JOURNAL_MTIME(&st) == b->mtime)) return RET_OK;
+	if (hasbak && ((unsigned long long)bst.st_size == b->size)) goto RESTORE_ID3_BACKUP_RENAME;
+
+	return RET_ERROR;
+
+  RESTORE_ID3_BACKUP_RENAME:
+	if (rename(bak, f->path)) return RET_ERROR;
+
+	// ߂ƂL^OɖOύXm肳
+	fd = open_id3_journal_dir(f->path);
+	if (fd < 0) return RET_ERROR;
+	res = fsync(fd);
+	close(fd);
+	if (res) return RET_ERROR;
+	fprintf(stderr, "journal : %s is restored from %s\n", f->path, bak);
+	return RET_OK;
+}
+
+
+/* restore_id3_tag **********************
+   JOURNAL_INPLACEŏn߂t@CɌ̃^Ö߂
+   opt [--collapse] Ő擪菜Ă΁A̕}߂Ă珑
+   ߂lF߂(߂Kv)0 ߂Ȃ-1
+****************************************/
+static int restore_id3_tag(const ID3JOURNALFILE *f) {
+	const ID3JOURNALREC *b = f->begin;
+	struct stat st;
+	unsigned long long cut = 0;
+	size_t done;
+	ssize_t n;
+	int fd;
+
+	if ((f->tag == NULL) || (b->taglen == 0)) return RET_ERROR;
+	fd = open(f->path, O_RDWR | O_CLOEXEC);
+	if (fd < 0) return RET_ERROR;
+	if (fstat(fd, &st) || (st.st_dev != b->dev) || (st.st_ino != b->ino)) goto RESTORE_ID3_TAG_ERROR;
+	if (((unsigned long long)st.st_size == b->size) && (JOURNAL_MTIME(&st) == b->mtime)) {
+		close(fd);
+		return RET_OK;
+	}
+
+	if ((unsigned long long)st.st_size < b->size) {
+		cut = b->size - st.st_size;
+		if ((cut >= b->taglen) || fallocate(fd, FALLOC_FL_INSERT_RANGE, 0, cut)) goto RESTORE_ID3_TAG_ERROR;
+	}
+	else if ((unsigned long long)st.st_size != b->size) goto RESTORE_ID3_TAG_ERROR;
+
+	for (done = 0; done < b->taglen; done += n) {
+		n = pwrite(fd, f->tag + done, b->taglen - done, done);
+		if (n < 0) {
+			if (errno == EINTR) {
+				n = 0;
+				continue;
+			}
+			goto RESTORE_ID3_TAG_ERROR;
+		}
+	}
+	if (fsync(fd)) goto RESTORE_ID3_TAG_ERROR;
+	close(fd);
+	fprintf(stderr, "journal : the tag of %s is restored\n", f->path);
+	return RET_OK;
+
+  RESTORE_ID3_TAG_ERROR:
+	close(fd);
+	return RET_ERROR;
+}
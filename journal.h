@@ -0,0 +1,101 @@
+/*
+  F
+    opt [--journal FILE] ̃ob`̋L^
+    Et@Cɐς(ADD)An߂(BEGIN)AI(END)
+      ǋLAfs̋NőĊJ
+    EBEGIN͏OfsyncAEND͂܂Ƃ߂fsync
+    EBEGIN̂܂܏IĂȂt@C.bakL^̃^O
+      Oɖ߂Ax
+
+  쐬ҁ@@Fgbm
+*/
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "id3tag.h"
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+#define JOURNAL_BACKUP 1     // .bakĂ珑 (rename / reflink)
+#define JOURNAL_INPLACE 2    // opt [-i] ̃^ÖL^Ă㏑
+
+
+
+/****************************************************/
+/*                      struct                      */
+/****************************************************/
+
+/* ID3journalrec *************************
+   L^1̌Œ蒷
+   path(pathlen byteANUL)ƃ^Ö(taglen byte)
+******************************************/
+typedef struct id3journalrec{
+	unsigned int magic;
+	unsigned int type;         // JOURNAL_HEAD / ADD / SCAN / BEGIN / END
+	int method;                // BEGIN: JOURNAL_BACKUP / JOURNAL_INPLACE  END: 
+	unsigned int pathlen;
+	unsigned long long taglen; // BEGIN(JOURNAL_INPLACE): ̃^Öbyte
+	unsigned long long dev;    // BEGIN: Õt@C
+	unsigned long long ino;
+	unsigned long long size;
+	unsigned long long mtime;  // ns
+	unsigned long long optkey; // HEAD: ʂɉeoption
+	unsigned long long sum;    // path,^Ö܂łhash (̌o)
+}ID3JOURNALREC;
+
+
+/* ID3journalfile ************************
+   L^t@C1̏
+******************************************/
+typedef struct id3journalfile{
+	char *path;
+	unsigned long long hash;   // pathhash
+	int state;                 // JOURNAL_ADD / BEGIN / END
+	int old;                   // O̎sp (܂ςݒĂȂ)
+	ID3JOURNALREC *begin;      // ǂݍݎAIĂȂBEGIN
+	unsigned char *tag;        // begiñ^Ö
+}ID3JOURNALFILE;
+
+
+/* ID3journal ****************************
+   L^̈ꗗƒǋL
+   (ob`[hworker瓯Ɏg)
+******************************************/
+typedef struct id3journal{
+	char path[FILENAME_MAX];
+	int fd;                    // ǋLp
+	off_t size;                // I܂ (͐؂l߂)
+	ID3JOURNALFILE *file;      // L^
+	size_t num;
+	size_t filecap;
+	size_t *table;             // pathhash  file[]̓Y+1 (0͋)
+	size_t tablesize;          // 2ׂ̂
+	size_t left;               // IĂȂt@C
+	size_t resume;             // O̎sp (file[]̐擪)
+	int scanned;               // O̎sŗ񋓂IĂ
+	int scandone;              // ̗񋓂I
+	unsigned long long optkey;
+	unsigned int unsynced;     // fsyncĂȂENĎ
+	double synctime;           // Ōfsync (bACLOCK_MONOTONIC)
+	pthread_mutex_t lock;
+}ID3JOURNAL;
+
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+unsigned long long get_id3_journal_key(const ID3OPTION *option);
+int open_id3_journal(ID3JOURNAL *j, const char *path, unsigned long long optkey);
+const char *next_id3_journal(ID3JOURNAL *j, size_t *i);
+int add_id3_journal(ID3JOURNAL *j, const char *path);
+int scan_id3_journal(ID3JOURNAL *j);
+int begin_id3_journal(ID3JOURNAL *j, const char *path, int method, const struct stat *st, const unsigned char *tag, size_t taglen);
+int end_id3_journal(ID3JOURNAL *j, const char *path, int result);
+int close_id3_journal(ID3JOURNAL *j);
+int open_id3_journal_dir(const char *path);
+
+#endif
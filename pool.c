@@ -0,0 +1,314 @@
+/*
+  F
+    [NXeB[ÕXbhv[
+    Esubmit_pool͊eworker̃L[֏ԂɎdς
+    Eworker͎̃L[̖o(LIFO)A
+      ɂȂΑworker̃L[̐擪瓐(FIFO)
+    E̎dmaxɒBsubmit_pool͋󂫂҂
+
+  쐬ҁ@@Fgbm
+*/
+
+
+/****************************************************/
+/*                     include                      */
+/****************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h> // sched_yield
+#include "pool.h"
+
+
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+#define RET_OK 0
+#define RET_ERROR -1
+
+#define DEQUE_INIT_SIZE 64
+
+
+
+/****************************************************/
+/*                      struct                      */
+/****************************************************/
+
+/* POOLdeque ****************************
+   worker̗[L[(Oobt@)
+****************************************/
+typedef struct pooldeque{
+	pthread_mutex_t lock;
+	void **item;
+	size_t cap;
+	size_t head;   // ܂鑤
+	size_t num;
+}POOLDEQUE;
+
+
+/* POOLworker ***************************/
+typedef struct poolworker{
+	struct id3pool *pool;
+	int id;
+	pthread_t thread;
+}POOLWORKER;
+
+
+/* ID3pool ******************************/
+struct id3pool{
+	int num;
+	int started;            // Nworker
+	POOLDEQUE *deque;
+	POOLWORKER *worker;
+	POOLFUNC func;
+	void *arg;
+
+	pthread_mutex_t lock;
+	pthread_cond_t wake;    // d҂workerN
+	pthread_cond_t space;   // 󂫑҂submit_poolN
+	size_t pending;         // ς܂(ςޓr܂)擾̎d (atomic)
+	size_t max;
+	int idle;               // d҂worker (atomic)
+	int next;               // ɐςރL[
+	int closed;
+};
+
+
+
+/****************************************************/
+/*                    Process                       */
+/****************************************************/
+
+/* push_deque ***************************
+   L[ɐς
+   ߂lF0 G[-1
+****************************************/
+static int push_deque(POOLDEQUE *dq, void *item) {
+	void **p;
+	size_t i;
+
+	pthread_mutex_lock(&dq->lock);
+	if (dq->num == dq->cap) {
+		p = malloc(sizeof(void *) * dq->cap * 2);
+		if (p == NULL) {
+			pthread_mutex_unlock(&dq->lock);
+			return RET_ERROR;
+		}
+		for (i = 0; i < dq->num; i++) p[i] = dq->item[(dq->head + i) % dq->cap];
+		free(dq->item);
+		dq->item = p;
+		dq->head = 0;
+		dq->cap *= 2;
+	}
+	dq->item[(dq->head + dq->num) % dq->cap] = item;
+	dq->num++;
+	pthread_mutex_unlock(&dq->lock);
+
+	return RET_OK;
+}
+
+
+/* pop_deque ****************************
+   steal: 0Ȃ疖()A1Ȃ擪(l)o
+   ߂lFdAȂNULL
+****************************************/
+static void *pop_deque(POOLDEQUE *dq, int steal) {
+	void *item = NULL;
+
+	pthread_mutex_lock(&dq->lock);
+	if (dq->num > 0) {
+		if (steal) {
+			item = dq->item[dq->head];
+			dq->head = (dq->head + 1) % dq->cap;
+		}
+		else {
+			item = dq->item[(dq->head + dq->num - 1) % dq->cap];
+		}
+		dq->num--;
+	}
+	pthread_mutex_unlock(&dq->lock);
+
+	return item;
+}
+
+
+/* take_item ****************************
+   ̃L[Aworker̃L[̏ɎdT
+   ߂lFdAȂNULL
+****************************************/
+static void *take_item(ID3POOL *pool, int id) {
+	void *item;
+	int i;
+
+	item = pop_deque(&pool->deque[id], 0);
+	for (i = 1; (item == NULL) && (i < pool->num); i++) {
+		item = pop_deque(&pool->deque[(id + i) % pool->num], 1);
+	}
+	if (item == NULL) return NULL;
+
+	// 󂫑҂submit_pool΋N
+	if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST) + 1 == pool->max) {
+		pthread_mutex_lock(&pool->lock);
+		pthread_cond_broadcast(&pool->space);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	return item;
+}
+
+
+/* pool_main ****************************
+   workerXbh{
+****************************************/
+static void *pool_main(void *arg) {
+	POOLWORKER *worker = arg;
+	ID3POOL *pool = worker->pool;
+	void *item;
+
+	while (1) {
+		item = take_item(pool, worker->id);
+		if (item != NULL) {
+			pool->func(item, worker->id, pool->arg);
+			continue;
+		}
+
+		// or̎d邾Ȃ班҂ĒT
+		if (__atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) > 0) {
+			sched_yield();
+			continue;
+		}
+
+		pthread_mutex_lock(&pool->lock);
+		__atomic_add_fetch(&pool->idle, 1, __ATOMIC_SEQ_CST);
+		while ((__atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) == 0) && !pool->closed) {
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		}
+		__atomic_sub_fetch(&pool->idle, 1, __ATOMIC_SEQ_CST);
+		if ((__atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) == 0) && pool->closed) {
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	return NULL;
+}
+
+
+/* create_pool **************************
+   numworkerN
+
+   max: ̎d̏ (0Ȃ疳)
+   func: d1֐
+   ߂lFv[AG[NULL
+****************************************/
+ID3POOL *create_pool(int num, size_t max, POOLFUNC func, void *arg) {
+	ID3POOL *pool;
+	int i;
+
+	if ((num < 1) || (num > POOL_WORKER_MAX)) return NULL;
+
+	pool = calloc(1, sizeof(ID3POOL));
+	if (pool == NULL) return NULL;
+	pool->deque = calloc(num, sizeof(POOLDEQUE));
+	pool->worker = calloc(num, sizeof(POOLWORKER));
+	if ((pool->deque == NULL) || (pool->worker == NULL)) goto CREATE_POOL_ERROR;
+
+	pool->num = num;
+	pool->max = max;
+	pool->func = func;
+	pool->arg = arg;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->space, NULL);
+
+	for (i = 0; i < num; i++) {
+		pthread_mutex_init(&pool->deque[i].lock, NULL);
+		pool->deque[i].cap = DEQUE_INIT_SIZE;
+		pool->deque[i].item = malloc(sizeof(void *) * DEQUE_INIT_SIZE);
+		if (pool->deque[i].item == NULL) goto CREATE_POOL_ERROR;
+	}
+
+	for (i = 0; i < num; i++) {
+		pool->worker[i].pool = pool;
+		pool->worker[i].id = i;
+		if (pthread_create(&pool->worker[i].thread, NULL, pool_main, &pool->worker[i])) {
+			// Nς݂worker͏I
+			finish_pool(pool);
+			return NULL;
+		}
+		pool->started++;
+	}
+
+	return pool;
+
+  CREATE_POOL_ERROR:
+	if (pool->deque != NULL) {
+		for (i = 0; i < num; i++) free(pool->deque[i].item);
+	}
+	free(pool->deque);
+	free(pool->worker);
+	free(pool);
+	return NULL;
+}
+
+
+/* submit_pool **************************
+   dς
+   ̎dmax΋󂭂܂ő҂
+
+   ߂lF0 G[-1
+****************************************/
+int submit_pool(ID3POOL *pool, void *item) {
+	if (pool->max > 0) {
+		pthread_mutex_lock(&pool->lock);
+		while (__atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) >= pool->max) {
+			pthread_cond_wait(&pool->space, &pool->lock);
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	// workerɎoĂႦȂ悤AςޑOɐ
+	__atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+	if (push_deque(&pool->deque[pool->next], item)) {
+		__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+		return RET_ERROR;
+	}
+	pool->next = (pool->next + 1) % pool->num;
+
+	// d҂worker΋N
+	if (__atomic_load_n(&pool->idle, __ATOMIC_SEQ_CST) > 0) {
+		pthread_mutex_lock(&pool->lock);
+		pthread_cond_signal(&pool->wake);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	return RET_OK;
+}
+
+
+/* finish_pool **************************
+   ς܂ꂽdSďÎ҂Av[
+****************************************/
+void finish_pool(ID3POOL *pool) {
+	int i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->closed = 1;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->started; i++) pthread_join(pool->worker[i].thread, NULL);
+
+	for (i = 0; i < pool->num; i++) {
+		pthread_mutex_destroy(&pool->deque[i].lock);
+		free(pool->deque[i].item);
+	}
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->wake);
+	pthread_cond_destroy(&pool->space);
+	free(pool->deque);
+	free(pool->worker);
+	free(pool);
+}
@@ -0,0 +1,32 @@
+/*
+  F
+    [NXeB[ÕXbhv[
+    eworker̃L[AɂȂƑworker
+    L[̔Αd𓐂
+
+  쐬ҁ@@Fgbm
+*/
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+#define POOL_WORKER_MAX 256
+
+// item: submit_poolœn, worker: workerԍ(0`), arg: create_poolœn
+typedef void (*POOLFUNC)(void *item, int worker, void *arg);
+
+typedef struct id3pool ID3POOL;
+
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+ID3POOL *create_pool(int num, size_t max, POOLFUNC func, void *arg);
+int submit_pool(ID3POOL *pool, void *item);
+void finish_pool(ID3POOL *pool);
+
+#endif
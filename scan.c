@@ -0,0 +1,467 @@
+/*
+  F
+    ^Öbyte1񂾂A"APIC"  "ima\0ge" ̌𐔂
+    E擪byteƖbyte16/32byte܂Ƃ߂ĔrA
+      vʒumemcmpŊmF
+    EAVX2gAVX2Ax86ȂSSE2AȊOscalarg
+      (ϐ ID3REPAIR_SCAN=avx2|sse2|scalar ŌŒł)
+    t[̋؂͌Ȃ߁A摜f[^̈vB
+    Ăяo0̏ꍇɃt[̑ȗ邽߂Ɏg
+    񓯊̉(FF 00 -> FF)ƕt(FF -> FF 00)@
+    FF̈ʒu܂Ƃ߂ĒTAFFubN͂̂܂܎ʂ
+
+  쐬ҁ@@Fgbm
+*/
+
+
+/****************************************************/
+/*                     include                      */
+/****************************************************/
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+#include "scan.h"
+
+
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+#define SCAN_APIC "APIC"
+#define SCAN_APIC_SIZE 4
+#define SCAN_APIC_LAST 3            // 'C' ̈ʒu
+#define SCAN_MIME "ima\0ge"
+#define SCAN_MIME_SIZE 6
+#define SCAN_MIME_LAST 5            // 'e' ̈ʒu
+#define SCAN_MIME_NUL_POS (10 + 4)  // t[wb_ + encode(1) + "ima"
+#define SCAN_COMP_POS 9             // t[wb_flag[1]
+#define SCAN_COMP_FLAG 0x80
+#define SCAN_TAIL 5                 // xNgrŐǂ݂byte
+#define UNSYNC_FF 0xFF
+#define UNSYNC_MIN 0xE0             // FF̌낪ȏォ00ł00
+
+#define SCAN_ENV "ID3REPAIR_SCAN"
+
+
+
+/****************************************************/
+/*                      struct                      */
+/****************************************************/
+typedef void (*SCANFUNC)(const unsigned char *buf, size_t size, ID3SCAN *scan);
+typedef size_t (*UNSYNCFUNC)(unsigned char *dst, const unsigned char *src, size_t size);
+
+/* ID3scankernel ************************
+   ֐ƖO
+****************************************/
+typedef struct id3scankernel{
+	const char *name;
+	SCANFUNC func;
+	UNSYNCFUNC decode;
+	UNSYNCFUNC encode;
+}ID3SCANKERNEL;
+
+
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+static void scan_hit(const unsigned char *buf, size_t size, size_t pos, ID3SCAN *scan);
+static void scan_scalar(const unsigned char *buf, size_t size, ID3SCAN *scan);
+static size_t copy_unsync_block(unsigned char *dst, size_t *out, const unsigned char *src, size_t pos, size_t width, unsigned int mask, int encode);
+static size_t decode_unsync_tail(unsigned char *dst, size_t out, const unsigned char *src, size_t size, size_t pos);
+static size_t encode_unsync_tail(unsigned char *dst, size_t out, const unsigned char *src, size_t size, size_t pos);
+static size_t decode_scalar(unsigned char *dst, const unsigned char *src, size_t size);
+static size_t encode_scalar(unsigned char *dst, const unsigned char *src, size_t size);
+#ifdef SCAN_X86
+static void scan_sse2(const unsigned char *buf, size_t size, ID3SCAN *scan);
+static void scan_avx2(const unsigned char *buf, size_t size, ID3SCAN *scan);
+static size_t decode_sse2(unsigned char *dst, const unsigned char *src, size_t size);
+static size_t encode_sse2(unsigned char *dst, const unsigned char *src, size_t size);
+static size_t decode_avx2(unsigned char *dst, const unsigned char *src, size_t size);
+static size_t encode_avx2(unsigned char *dst, const unsigned char *src, size_t size);
+#endif
+static const ID3SCANKERNEL *select_scan_kernel(void);
+
+
+
+/****************************************************/
+/*                     global                       */
+/****************************************************/
+static const ID3SCANKERNEL g_scan_kernel[] = {
+#ifdef SCAN_X86
+	{"avx2", scan_avx2, decode_avx2, encode_avx2},
+	{"sse2", scan_sse2, decode_sse2, encode_sse2},
+#endif
+	{"scalar", scan_scalar, decode_scalar, encode_scalar},
+	{NULL, NULL, NULL, NULL}
+};
+
+static const ID3SCANKERNEL *g_scan_select = NULL;   // atomicœǂݏ
+
+
+
+/****************************************************/
+/*                    Process                       */
+/****************************************************/
+
+/* scan_id3_tag *************************
+   buf[0]`buf[size-1]𐔂scanɓ
+****************************************/
+void scan_id3_tag(const unsigned char *buf, size_t size, ID3SCAN *scan) {
+	memset(scan, 0, sizeof(*scan));
+	if (buf == NULL || size == 0) return;
+
+	select_scan_kernel()->func(buf, size, scan);
+}
+
+
+/* decode_id3_unsync ********************
+   񓯊 (FF̒00)
+   dst: size byteȏ (srcƏdȂȂ)
+   ߂lFdstɏbyte
+****************************************/
+size_t decode_id3_unsync(unsigned char *dst, const unsigned char *src, size_t size) {
+	if (size == 0) return 0;
+	return select_scan_kernel()->decode(dst, src, size);
+}
+
+
+/* encode_id3_unsync ********************
+   񓯊 (FF̒オ00E0ȏA܂FFŏIꍇ00)
+   dst: UNSYNC_ENCODE_MAX(size) byteȏ (srcƏdȂȂ)
+   ߂lFdstɏbyte
+****************************************/
+size_t encode_id3_unsync(unsigned char *dst, const unsigned char *src, size_t size) {
+	if (size == 0) return 0;
+	return select_scan_kernel()->encode(dst, src, size);
+}
+
+
+/* get_scan_kernel **********************
+   ߂lFgp鑖֐̖O
+****************************************/
+const char *get_scan_kernel(void) {
+	return select_scan_kernel()->name;
+}
+
+
+/* select_scan_kernel *******************
+   CPU𒲂ׂđ֐߂
+   (Xbh瓯ɌĂ΂ĂʂɂȂ)
+****************************************/
+static const ID3SCANKERNEL *select_scan_kernel(void) {
+	const ID3SCANKERNEL *k;
+	const char *env;
+
+	k = __atomic_load_n(&g_scan_select, __ATOMIC_ACQUIRE);
+	if (k != NULL) return k;
+
+	env = getenv(SCAN_ENV);
+	for (k = g_scan_kernel; k->name != NULL; k++) {
+		if (env != NULL && *env != '\0') {
+			if (0 == strcmp(env, k->name)) break;
+			continue;
+		}
+#ifdef SCAN_X86
+		if (k->func == scan_avx2) {
+			__builtin_cpu_init();
+			if (! __builtin_cpu_supports("avx2")) continue;
+		}
+#endif
+		break;
+	}
+	if (k->name == NULL) k = &(g_scan_kernel[sizeof(g_scan_kernel) / sizeof(g_scan_kernel[0]) - 2]); // scalar
+
+	__atomic_store_n(&g_scan_select, k, __ATOMIC_RELEASE);
+	return k;
+}
+
+
+/* scan_hit *****************************
+   擪ƖvposʒumFĐ
+****************************************/
+static void scan_hit(const unsigned char *buf, size_t size, size_t pos, ID3SCAN *scan) {
+	if (buf[pos] == SCAN_APIC[0]) {
+		if (pos + SCAN_APIC_SIZE > size) return;
+		if (memcmp(buf + pos, SCAN_APIC, SCAN_APIC_SIZE)) return;
+		scan->apic++;
+		if ((pos + SCAN_MIME_NUL_POS < size) && (buf[pos + SCAN_MIME_NUL_POS] == 0)) scan->apicnul++;
+		if ((pos + SCAN_COMP_POS < size) && (buf[pos + SCAN_COMP_POS] & SCAN_COMP_FLAG)) scan->apiccomp++;
+	}
+	else if (buf[pos] == SCAN_MIME[0]) {
+		if (pos + SCAN_MIME_SIZE > size) return;
+		if (memcmp(buf + pos, SCAN_MIME, SCAN_MIME_SIZE)) return;
+		scan->mime++;
+	}
+}
+
+
+/* scan_scalar **************************
+   1byter
+****************************************/
+static void scan_scalar(const unsigned char *buf, size_t size, ID3SCAN *scan) {
+	size_t pos;
+
+	for (pos = 0; pos < size; pos++) {
+		if (buf[pos] == SCAN_APIC[0] || buf[pos] == SCAN_MIME[0]) scan_hit(buf, size, pos, scan);
+	}
+}
+
+
+/* copy_unsync_block ********************
+   src[pos] width bytedst֎ʂ
+   mask: 00(decode)/(encode)FF̈ʒu (bit i  src[pos + i])
+   decodeł͍ŌFF̎00ubN̊OɂĂ
+   ߂lFɓǂsrc̈ʒu
+****************************************/
+static size_t copy_unsync_block(unsigned char *dst, size_t *out, const unsigned char *src, size_t pos, size_t width, unsigned int mask, int encode) {
+	size_t i, last = 0;
+
+	while (mask) {
+		i = __builtin_ctz(mask);
+		memcpy(dst + *out, src + pos + last, i + 1 - last);
+		*out += i + 1 - last;
+		if (encode) {
+			dst[(*out)++] = 0;
+			last = i + 1;
+		}
+		else last = i + 2;
+		mask &= mask - 1;
+	}
+	if (last < width) {
+		memcpy(dst + *out, src + pos + last, width - last);
+		*out += width - last;
+		last = width;
+	}
+
+	return pos + last;
+}
+
+
+/* decode_unsync_tail *******************
+   src[pos]`1byte
+   ߂lFdstɏbyte (out܂)
+****************************************/
+static size_t decode_unsync_tail(unsigned char *dst, size_t out, const unsigned char *src, size_t size, size_t pos) {
+	while (pos < size) {
+		dst[out++] = src[pos];
+		if ((src[pos] == UNSYNC_FF) && (pos + 1 < size) && (src[pos + 1] == 0)) pos++;
+		pos++;
+	}
+	return out;
+}
+
+
+/* encode_unsync_tail *******************
+   src[pos]`1byte񓯊
+   ߂lFdstɏbyte (out܂)
+****************************************/
+static size_t encode_unsync_tail(unsigned char *dst, size_t out, const unsigned char *src, size_t size, size_t pos) {
+	while (pos < size) {
+		dst[out++] = src[pos];
+		if ((src[pos] == UNSYNC_FF)
+			&& ((pos + 1 == size) || (src[pos + 1] == 0) || (src[pos + 1] >= UNSYNC_MIN))) dst[out++] = 0;
+		pos++;
+	}
+	return out;
+}
+
+
+/* decode_scalar ************************/
+static size_t decode_scalar(unsigned char *dst, const unsigned char *src, size_t size) {
+	return decode_unsync_tail(dst, 0, src, size, 0);
+}
+
+
+/* encode_scalar ************************/
+static size_t encode_scalar(unsigned char *dst, const unsigned char *src, size_t size) {
+	return encode_unsync_tail(dst, 0, src, size, 0);
+}
+
+
+#ifdef SCAN_X86
+/* scan_sse2 ****************************
+   16byter
+****************************************/
+static void scan_sse2(const unsigned char *buf, size_t size, ID3SCAN *scan) {
+	const __m128i apic0 = _mm_set1_epi8(SCAN_APIC[0]);
+	const __m128i apic3 = _mm_set1_epi8(SCAN_APIC[SCAN_APIC_LAST]);
+	const __m128i mime0 = _mm_set1_epi8(SCAN_MIME[0]);
+	const __m128i mime5 = _mm_set1_epi8(SCAN_MIME[SCAN_MIME_LAST]);
+	__m128i b0, hit;
+	unsigned int mask;
+	size_t pos;
+
+	for (pos = 0; pos + 16 + SCAN_TAIL <= size; pos += 16) {
+		b0 = _mm_loadu_si128((const __m128i *)(buf + pos));
+		hit = _mm_and_si128(_mm_cmpeq_epi8(b0, apic0),
+				_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(buf + pos + SCAN_APIC_LAST)), apic3));
+		hit = _mm_or_si128(hit, _mm_and_si128(_mm_cmpeq_epi8(b0, mime0),
+				_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(buf + pos + SCAN_MIME_LAST)), mime5)));
+		mask = _mm_movemask_epi8(hit);
+		while (mask) {
+			scan_hit(buf, size, pos + __builtin_ctz(mask), scan);
+			mask &= mask - 1;
+		}
+	}
+
+	// c
+	for (; pos < size; pos++) {
+		if (buf[pos] == SCAN_APIC[0] || buf[pos] == SCAN_MIME[0]) scan_hit(buf, size, pos, scan);
+	}
+}
+
+
+/* scan_avx2 ****************************
+   32byter
+****************************************/
+__attribute__((target("avx2")))
+static void scan_avx2(const unsigned char *buf, size_t size, ID3SCAN *scan) {
+	const __m256i apic0 = _mm256_set1_epi8(SCAN_APIC[0]);
+	const __m256i apic3 = _mm256_set1_epi8(SCAN_APIC[SCAN_APIC_LAST]);
+	const __m256i mime0 = _mm256_set1_epi8(SCAN_MIME[0]);
+	const __m256i mime5 = _mm256_set1_epi8(SCAN_MIME[SCAN_MIME_LAST]);
+	__m256i b0, hit;
+	unsigned int mask;
+	size_t pos;
+
+	for (pos = 0; pos + 32 + SCAN_TAIL <= size; pos += 32) {
+		b0 = _mm256_loadu_si256((const __m256i *)(buf + pos));
+		hit = _mm256_and_si256(_mm256_cmpeq_epi8(b0, apic0),
+				_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(buf + pos + SCAN_APIC_LAST)), apic3));
+		hit = _mm256_or_si256(hit, _mm256_and_si256(_mm256_cmpeq_epi8(b0, mime0),
+				_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(buf + pos + SCAN_MIME_LAST)), mime5)));
+		mask = (unsigned int)_mm256_movemask_epi8(hit);
+		while (mask) {
+			scan_hit(buf, size, pos + __builtin_ctz(mask), scan);
+			mask &= mask - 1;
+		}
+	}
+
+	// c
+	for (; pos < size; pos++) {
+		if (buf[pos] == SCAN_APIC[0] || buf[pos] == SCAN_MIME[0]) scan_hit(buf, size, pos, scan);
+	}
+}
+
+
+/* decode_sse2 **************************
+   16byte "FF 00" T
+****************************************/
+static size_t decode_sse2(unsigned char *dst, const unsigned char *src, size_t size) {
+	const __m128i ff = _mm_set1_epi8((char)UNSYNC_FF);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i b0;
+	unsigned int mask;
+	size_t pos = 0, out = 0;
+
+	while (pos + 16 + 1 <= size) {
+		b0 = _mm_loadu_si128((const __m128i *)(src + pos));
+		mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(b0, ff),
+				_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(src + pos + 1)), zero)));
+		if (mask == 0) {
+			_mm_storeu_si128((__m128i *)(dst + out), b0);
+			pos += 16;
+			out += 16;
+			continue;
+		}
+		pos = copy_unsync_block(dst, &out, src, pos, 16, mask, 0);
+	}
+
+	// c
+	return decode_unsync_tail(dst, out, src, size, pos);
+}
+
+
+/* encode_sse2 **************************
+   16byte00FFT
+****************************************/
+static size_t encode_sse2(unsigned char *dst, const unsigned char *src, size_t size) {
+	const __m128i ff = _mm_set1_epi8((char)UNSYNC_FF);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i min = _mm_set1_epi8((char)UNSYNC_MIN);
+	__m128i b0, b1;
+	unsigned int mask;
+	size_t pos = 0, out = 0;
+
+	while (pos + 16 + 1 <= size) {
+		b0 = _mm_loadu_si128((const __m128i *)(src + pos));
+		b1 = _mm_loadu_si128((const __m128i *)(src + pos + 1));
+		mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(b0, ff),
+				_mm_or_si128(_mm_cmpeq_epi8(b1, zero), _mm_cmpeq_epi8(_mm_max_epu8(b1, min), b1))));
+		if (mask == 0) {
+			_mm_storeu_si128((__m128i *)(dst + out), b0);
+			pos += 16;
+			out += 16;
+			continue;
+		}
+		pos = copy_unsync_block(dst, &out, src, pos, 16, mask, 1);
+	}
+
+	// c
+	return encode_unsync_tail(dst, out, src, size, pos);
+}
+
+
+/* decode_avx2 **************************
+   32byte "FF 00" T
+****************************************/
+__attribute__((target("avx2")))
+static size_t decode_avx2(unsigned char *dst, const unsigned char *src, size_t size) {
+	const __m256i ff = _mm256_set1_epi8((char)UNSYNC_FF);
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i b0;
+	unsigned int mask;
+	size_t pos = 0, out = 0;
+
+	while (pos + 32 + 1 <= size) {
+		b0 = _mm256_loadu_si256((const __m256i *)(src + pos));
+		mask = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(b0, ff),
+				_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(src + pos + 1)), zero)));
+		if (mask == 0) {
+			_mm256_storeu_si256((__m256i *)(dst + out), b0);
+			pos += 32;
+			out += 32;
+			continue;
+		}
+		pos = copy_unsync_block(dst, &out, src, pos, 32, mask, 0);
+	}
+
+	// c
+	return decode_unsync_tail(dst, out, src, size, pos);
+}
+
+
+/* encode_avx2 **************************
+   32byte00FFT
+****************************************/
+__attribute__((target("avx2")))
+static size_t encode_avx2(unsigned char *dst, const unsigned char *src, size_t size) {
+	const __m256i ff = _mm256_set1_epi8((char)UNSYNC_FF);
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i min = _mm256_set1_epi8((char)UNSYNC_MIN);
+	__m256i b0, b1;
+	unsigned int mask;
+	size_t pos = 0, out = 0;
+
+	while (pos + 32 + 1 <= size) {
+		b0 = _mm256_loadu_si256((const __m256i *)(src + pos));
+		b1 = _mm256_loadu_si256((const __m256i *)(src + pos + 1));
+		mask = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(b0, ff),
+				_mm256_or_si256(_mm256_cmpeq_epi8(b1, zero), _mm256_cmpeq_epi8(_mm256_max_epu8(b1, min), b1))));
+		if (mask == 0) {
+			_mm256_storeu_si256((__m256i *)(dst + out), b0);
+			pos += 32;
+			out += 32;
+			continue;
+		}
+		pos = copy_unsync_block(dst, &out, src, pos, 32, mask, 1);
+	}
+
+	// c
+	return encode_unsync_tail(dst, out, src, size, pos);
+}
+#endif
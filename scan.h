@@ -0,0 +1,46 @@
+/*
+  F
+    ^Öbyte񂩂 "APIC" t[ID
+    ꂽMIME^Cv "ima\0ge" 1̑ŒTo
+    񓯊(unsynchronisation)̉ƕts
+    (SSE2/AVX2Aǂscalar)
+
+  쐬ҁ@@Fgbm
+*/
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+#define UNSYNC_ENCODE_MAX(n) ((n) * 2)  // encode_id3_unsync̏o͂̍őbyte
+
+
+
+/****************************************************/
+/*                      struct                      */
+/****************************************************/
+
+/* ID3scan ******************************
+   scan_id3_taǧ
+   t[E͌ĂȂ̂Ő͌␔ł
+****************************************/
+typedef struct id3scan{
+	unsigned int apic;         // "APIC" ̏o
+	unsigned int apicnul;      // ̂MIME4byteڂ0̂
+	unsigned int apiccomp;     // ̂ktOĂ (MIME͌Ȃ)
+	unsigned int mime;         // "ima\0ge" ̏o
+}ID3SCAN;
+
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+void scan_id3_tag(const unsigned char *buf, size_t size, ID3SCAN *scan);
+size_t decode_id3_unsync(unsigned char *dst, const unsigned char *src, size_t size);
+size_t encode_id3_unsync(unsigned char *dst, const unsigned char *src, size_t size);
+const char *get_scan_kernel(void);
+
+#endif
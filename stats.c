@@ -0,0 +1,227 @@
+/*
+  F
+    opt [--stats] ̌vƏo
+    Estart_id3_stats / stop_id3_stats ŒiK̎Ԃ𑫂
+      (statsNULLłΉȂ̂ŁAvȂꍇ̂܂܌Ăׂ)
+    Ebegin_id3_stats / end_id3_stats Ńt@C1̑S̎Ԃ
+      I/OJE^̍BI/O/proc/thread-self/ioǂނ
+      stdiocopy_file_range̓Ŕsꂽ܂܂
+      (1Xbh1t@CĂꍇ̂ݐ)
+    Eprint_id3_statsŃeLXgJSON(1s1IuWFNg)o͂
+
+  쐬ҁ@@Fgbm
+*/
+
+
+/****************************************************/
+/*                     include                      */
+/****************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "stats.h"
+
+
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+#define STATS_IO_PATH "/proc/thread-self/io"
+#define STATS_IO_BUF_SIZE 512
+
+#define MSEC(sec) ((sec) * 1000.0)
+
+
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+static void now_id3_timer(ID3TIMER *t);
+static void read_id3_iocount(ID3IOCOUNT *io);
+static void print_json_string(FILE *fp, const char *str);
+
+
+
+/****************************************************/
+/*                     global                       */
+/****************************************************/
+static const char *g_phase_name[STATS_PHASE_NUM] = {
+	"parse", "walk", "apic", "backup", "tag", "copy", "total"
+};
+
+
+
+/****************************************************/
+/*                    Process                       */
+/****************************************************/
+
+/* start_id3_stats **********************
+   phasěvJn
+****************************************/
+void start_id3_stats(ID3STATS *stats, int phase) {
+	if (stats == NULL) return;
+	now_id3_timer(&(stats->timer[phase]));
+}
+
+
+/* stop_id3_stats ***********************
+   start_id3_stats̎Ԃphaseɑ
+****************************************/
+void stop_id3_stats(ID3STATS *stats, int phase) {
+	ID3TIMER t;
+
+	if (stats == NULL) return;
+	now_id3_timer(&t);
+	stats->wall[phase] += t.wall - stats->timer[phase].wall;
+	stats->cpu[phase] += t.cpu - stats->timer[phase].cpu;
+}
+
+
+/* begin_id3_stats **********************
+   t@C1̌vJn
+****************************************/
+void begin_id3_stats(ID3STATS *stats) {
+	if (stats == NULL) return;
+	memset(stats, 0, sizeof(*stats));
+	stats->files = 1;
+	read_id3_iocount(&(stats->io));
+	start_id3_stats(stats, STATS_TOTAL);
+}
+
+
+/* end_id3_stats ************************
+   t@C1̌vIAI/O̍𑫂
+   (JnɃJE^ǂread()̕͏)
+****************************************/
+void end_id3_stats(ID3STATS *stats) {
+	ID3IOCOUNT io;
+
+	if (stats == NULL) return;
+	stop_id3_stats(stats, STATS_TOTAL);
+	read_id3_iocount(&io);
+	if (! (io.valid && stats->io.valid)) return;
+
+	stats->reads += io.syscr - stats->io.syscr - 1;
+	stats->readbytes += io.rchar - stats->io.rchar - stats->io.self;
+	stats->writes += io.syscw - stats->io.syscw;
+	stats->writebytes += io.wchar - stats->io.wchar;
+}
+
+
+/* add_id3_stats ************************
+   statstotalɑ
+****************************************/
+void add_id3_stats(ID3STATS *total, const ID3STATS *stats) {
+	int i;
+
+	total->files += stats->files;
+	for (i = 0; i < STATS_PHASE_NUM; i++) {
+		total->wall[i] += stats->wall[i];
+		total->cpu[i] += stats->cpu[i];
+	}
+	total->reads += stats->reads;
+	total->readbytes += stats->readbytes;
+	total->writes += stats->writes;
+	total->writebytes += stats->writebytes;
+	total->seeks += stats->seeks;
+	total->kept += stats->kept;
+	total->deleted += stats->deleted;
+	total->patched += stats->patched;
+}
+
+
+/* print_id3_stats **********************
+   stats1sŏo͂
+   filename: NULLłΏWvlƂďo͂
+   format: STATS_TEXT / STATS_JSON
+****************************************/
+void print_id3_stats(FILE *fp, const char *filename, const ID3STATS *stats, int format) {
+	int i;
+
+	if (format == STATS_JSON) {
+		fprintf(fp, "{\"file\":");
+		if (filename != NULL) print_json_string(fp, filename);
+		else fprintf(fp, "null");
+		fprintf(fp, ",\"files\":%u,\"phase\":{", stats->files);
+		for (i = 0; i < STATS_PHASE_NUM; i++) {
+			fprintf(fp, "%s\"%s\":{\"wall_ms\":%.3f,\"cpu_ms\":%.3f}", i ? "," : "",
+					g_phase_name[i], MSEC(stats->wall[i]), MSEC(stats->cpu[i]));
+		}
+		fprintf(fp, "},\"read\":{\"calls\":%llu,\"bytes\":%llu},\"write\":{\"calls\":%llu,\"bytes\":%llu}",
+				stats->reads, stats->readbytes, stats->writes, stats->writebytes);
+		fprintf(fp, ",\"seeks\":%llu,\"frames\":{\"kept\":%llu,\"deleted\":%llu,\"patched\":%llu}}\n",
+				stats->seeks, stats->kept, stats->deleted, stats->patched);
+		return;
+	}
+
+	fprintf(fp, "stats\t%s\tfiles=%u", (filename != NULL) ? filename : "(total)", stats->files);
+	for (i = 0; i < STATS_PHASE_NUM; i++) {
+		fprintf(fp, " %s=%.3f/%.3fms", g_phase_name[i], MSEC(stats->wall[i]), MSEC(stats->cpu[i]));
+	}
+	fprintf(fp, " read=%llu/%lluB write=%llu/%lluB seek=%llu kept=%llu deleted=%llu patched=%llu\n",
+			stats->reads, stats->readbytes, stats->writes, stats->writebytes,
+			stats->seeks, stats->kept, stats->deleted, stats->patched);
+}
+
+
+/* now_id3_timer ************************
+   oߎԂƃXbhCPUԂ擾
+****************************************/
+static void now_id3_timer(ID3TIMER *t) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t->wall = ts.tv_sec + ts.tv_nsec / 1e9;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	t->cpu = ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* read_id3_iocount *********************
+   ĂяoXbhI/OJE^ǂ
+   ǂ߂Ȃio->valid0ɂȂ
+****************************************/
+static void read_id3_iocount(ID3IOCOUNT *io) {
+	char buf[STATS_IO_BUF_SIZE];
+	char *p, *q;
+	unsigned long long n;
+	ssize_t len;
+	int fd, found = 0;
+
+	memset(io, 0, sizeof(*io));
+	fd = open(STATS_IO_PATH, O_RDONLY);
+	if (fd < 0) return;
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0) return;
+	buf[len] = '\0';
+	io->self = len;
+
+	for (p = buf; p != NULL && *p != '\0'; p = (q != NULL) ? q + 1 : NULL) {
+		q = strchr(p, '\n');
+		if (1 == sscanf(p, "rchar: %llu", &n)) { io->rchar = n; found++; }
+		else if (1 == sscanf(p, "wchar: %llu", &n)) { io->wchar = n; found++; }
+		else if (1 == sscanf(p, "syscr: %llu", &n)) { io->syscr = n; found++; }
+		else if (1 == sscanf(p, "syscw: %llu", &n)) { io->syscw = n; found++; }
+	}
+	io->valid = (found == 4);
+}
+
+
+/* print_json_string ********************
+   strJSON̕Ƃďo͂
+****************************************/
+static void print_json_string(FILE *fp, const char *str) {
+	const unsigned char *p;
+
+	fputc('"', fp);
+	for (p = (const unsigned char *)str; *p != '\0'; p++) {
+		if ((*p == '"') || (*p == '\\')) fprintf(fp, "\\%c", *p);
+		else if (*p < 0x20) fprintf(fp, "\\u%04x", *p);
+		else fputc(*p, fp);
+	}
+	fputc('"', fp);
+}
@@ -0,0 +1,89 @@
+/*
+  F
+    opt [--stats] ̌vl
+    EiǨoߎԂCPU
+    Eread/writenVXeR[̉񐔂byteAseek
+    Et[̏
+
+  쐬ҁ@@Fgbm
+*/
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+#define STATS_OFF 0
+#define STATS_TEXT 1
+#define STATS_JSON 2
+
+#define STATS_PARSE 0    // wb_ǂݍ݁E
+#define STATS_WALK 1     // t[ꗗ̍쐬
+#define STATS_APIC 2     // et[̏ (APICmF)
+#define STATS_BACKUP 3   // .bak̍쐬
+#define STATS_TAG 4      // ^Ȍo
+#define STATS_COPY 5     // f[^̈̃Rs[
+#define STATS_TOTAL 6    // t@C1S
+#define STATS_PHASE_NUM 7
+
+
+
+/****************************************************/
+/*                      struct                      */
+/****************************************************/
+
+/* ID3timer *****************************
+   start_id3_timerŊJn
+****************************************/
+typedef struct id3timer{
+	double wall;
+	double cpu;
+}ID3TIMER;
+
+
+/* ID3iocount ***************************
+   XbhPʂI/OJE^ (/proc/thread-self/io)
+****************************************/
+typedef struct id3iocount{
+	unsigned long long rchar;
+	unsigned long long wchar;
+	unsigned long long syscr;
+	unsigned long long syscw;
+	unsigned long long self;   // ̃JE^ǂread()byte
+	int valid;
+}ID3IOCOUNT;
+
+
+/* ID3stats *****************************
+   t@CA܂͏Wvvl
+****************************************/
+typedef struct id3stats{
+	unsigned int files;
+	double wall[STATS_PHASE_NUM];  // b
+	double cpu[STATS_PHASE_NUM];
+	unsigned long long reads;
+	unsigned long long readbytes;
+	unsigned long long writes;
+	unsigned long long writebytes;
+	unsigned long long seeks;
+	unsigned long long kept;
+	unsigned long long deleted;
+	unsigned long long patched;
+	ID3TIMER timer[STATS_PHASE_NUM];  // v̊Jn
+	ID3IOCOUNT io;                    // t@CJnI/OJE^
+}ID3STATS;
+
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+void start_id3_stats(ID3STATS *stats, int phase);
+void stop_id3_stats(ID3STATS *stats, int phase);
+void begin_id3_stats(ID3STATS *stats);
+void end_id3_stats(ID3STATS *stats);
+void add_id3_stats(ID3STATS *total, const ID3STATS *stats);
+void print_id3_stats(FILE *fp, const char *filename, const ID3STATS *stats, int format);
+
+#endif
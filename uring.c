@@ -0,0 +1,248 @@
+/*
+  F
+    io_uring̍ŏ̃bp[ (liburing͎gȂ)
+    Einit_uringŃO쐬mmap
+    Eget_uring_sqeŎ擾SQEprep_uring_*œeݒ肵A
+      submit_uringł܂Ƃ߂ăJ[lɓn
+    Epeek_uring_cqeŎoAseen_uring_cqeŕԋp
+    J[lio_uringɑΉĂȂinit_uringG[Ԃ
+    Xopg邩probe_uring_opŒׂ
+
+  Ql :
+     https://kernel.dk/io_uring.pdf
+
+  쐬ҁ@@Fgbm
+*/
+
+
+/****************************************************/
+/*                     include                      */
+/****************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h> // AT_FDCWD
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "uring.h"
+
+
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+#define RET_OK 0
+#define RET_ERROR -1
+
+#define PROBE_OPS 256    // probeŎ󂯎op̍ő吔
+
+#define LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+
+
+/****************************************************/
+/*                    Process                       */
+/****************************************************/
+
+/* init_uring ***************************
+   entriesSQEO쐬
+   ߂lF0 G[(Ή܂)-1
+****************************************/
+int init_uring(ID3URING *ring, unsigned int entries) {
+	struct io_uring_params p;
+
+	memset(ring, 0, sizeof(*ring));
+	memset(&p, 0, sizeof(p));
+	ring->fd = -1;
+
+#ifdef __NR_io_uring_setup
+	ring->fd = syscall(__NR_io_uring_setup, entries, &p);
+#else
+	errno = ENOSYS;
+#endif
+	if (ring->fd < 0) return RET_ERROR;
+
+	// SQOCQO (SINGLE_MMAPłΓ̈)
+	ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_len > ring->sq_len) ring->sq_len = ring->cq_len;
+		ring->cq_len = ring->sq_len;
+	}
+	ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ptr == MAP_FAILED) goto INIT_URING_ERROR;
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ptr = ring->sq_ptr;
+	}
+	else {
+		ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+							ring->fd, IORING_OFF_CQ_RING);
+		if (ring->cq_ptr == MAP_FAILED) goto INIT_URING_ERROR;
+	}
+
+	// SQEz
+	ring->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+					  MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) goto INIT_URING_ERROR;
+
+	ring->sq_head = (unsigned int *)((char *)ring->sq_ptr + p.sq_off.head);
+	ring->sq_tail = (unsigned int *)((char *)ring->sq_ptr + p.sq_off.tail);
+	ring->sq_mask = (unsigned int *)((char *)ring->sq_ptr + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *)((char *)ring->sq_ptr + p.sq_off.array);
+	ring->cq_head = (unsigned int *)((char *)ring->cq_ptr + p.cq_off.head);
+	ring->cq_tail = (unsigned int *)((char *)ring->cq_ptr + p.cq_off.tail);
+	ring->cq_mask = (unsigned int *)((char *)ring->cq_ptr + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ptr + p.cq_off.cqes);
+	ring->sq_entries = p.sq_entries;
+
+	return RET_OK;
+
+  INIT_URING_ERROR:
+	if (ring->sqes == MAP_FAILED) ring->sqes = NULL;
+	if (ring->cq_ptr == MAP_FAILED) ring->cq_ptr = NULL;
+	if (ring->sq_ptr == MAP_FAILED) ring->sq_ptr = NULL;
+	exit_uring(ring);
+	return RET_ERROR;
+}
+
+
+/* probe_uring_op ***********************
+   IORING_REGISTER_PROBEopg邩ׂ
+   (probeLinux 5.6ȍ~BREAD/WRITE5.6ȍ~Ȃ̂ŁA
+    probesΎgȂ̂ƂĈ)
+
+   ߂lFg1 gȂ0 probeΉȂ-1
+****************************************/
+int probe_uring_op(ID3URING *ring, int op) {
+	struct io_uring_probe *probe;
+	int ret = RET_ERROR;
+
+	probe = calloc(1, sizeof(*probe) + PROBE_OPS * sizeof(struct io_uring_probe_op));
+	if (probe == NULL) return RET_ERROR;
+#ifdef __NR_io_uring_register
+	if (0 == syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, PROBE_OPS)) {
+		ret = ((op <= probe->last_op) && (op < probe->ops_len)
+			   && (probe->ops[op].flags & IO_URING_OP_SUPPORTED)) ? 1 : 0;
+	}
+#endif
+	free(probe);
+
+	return ret;
+}
+
+
+/* exit_uring ***************************
+   O
+****************************************/
+void exit_uring(ID3URING *ring) {
+	if (ring->sqes != NULL) munmap(ring->sqes, ring->sq_entries * sizeof(struct io_uring_sqe));
+	if ((ring->cq_ptr != NULL) && (ring->cq_ptr != ring->sq_ptr)) munmap(ring->cq_ptr, ring->cq_len);
+	if (ring->sq_ptr != NULL) munmap(ring->sq_ptr, ring->sq_len);
+	if (ring->fd >= 0) close(ring->fd);
+	memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+}
+
+
+/* get_uring_sqe ************************
+   󂢂ĂSQE擾
+   SQtłΐsubmit
+
+   ߂lFSQEA擾łȂNULL
+****************************************/
+struct io_uring_sqe *get_uring_sqe(ID3URING *ring) {
+	struct io_uring_sqe *sqe;
+	unsigned int tail = *ring->sq_tail;
+	unsigned int idx;
+
+	if (tail - LOAD_ACQUIRE(ring->sq_head) >= ring->sq_entries) {
+		if (submit_uring(ring, 0) < 0) return NULL;
+		if (tail - LOAD_ACQUIRE(ring->sq_head) >= ring->sq_entries) return NULL;
+	}
+
+	idx = tail & *ring->sq_mask;
+	sqe = &(ring->sqes[idx]);
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[idx] = idx;
+	STORE_RELEASE(ring->sq_tail, tail + 1);
+	ring->sq_pending++;
+
+	return sqe;
+}
+
+
+/* submit_uring *************************
+   ς݂SQEsubmitAwait̊҂
+
+   ߂lFsubmitAG[-1
+****************************************/
+int submit_uring(ID3URING *ring, unsigned int wait) {
+	int ret;
+
+	if ((ring->sq_pending == 0) && (wait == 0)) return 0;
+	do {
+		ret = syscall(__NR_io_uring_enter, ring->fd, ring->sq_pending, wait,
+					  wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	} while ((ret < 0) && (errno == EINTR));
+	if (ret < 0) return RET_ERROR;
+	ring->sq_pending -= ret;
+
+	return ret;
+}
+
+
+/* peek_uring_cqe ***********************
+   ߂lFCQEAȂNULL
+****************************************/
+struct io_uring_cqe *peek_uring_cqe(ID3URING *ring) {
+	unsigned int head = *ring->cq_head;
+
+	if (head == LOAD_ACQUIRE(ring->cq_tail)) return NULL;
+	return &(ring->cqes[head & *ring->cq_mask]);
+}
+
+
+/* seen_uring_cqe ***********************
+   peek_uring_cqeŎoCQEԋp
+****************************************/
+void seen_uring_cqe(ID3URING *ring) {
+	STORE_RELEASE(ring->cq_head, *ring->cq_head + 1);
+}
+
+
+/* prep_uring_rw ************************
+   IORING_OP_READ / IORING_OP_WRITE
+****************************************/
+void prep_uring_rw(struct io_uring_sqe *sqe, int op, int fd, void *buf, unsigned int len, off_t off, unsigned long long data) {
+	sqe->opcode = op;
+	sqe->fd = fd;
+	sqe->addr = (unsigned long)buf;
+	sqe->len = len;
+	sqe->off = off;
+	sqe->user_data = data;
+}
+
+
+/* prep_uring_fsync *********************/
+void prep_uring_fsync(struct io_uring_sqe *sqe, int fd, unsigned long long data) {
+	sqe->opcode = IORING_OP_FSYNC;
+	sqe->fd = fd;
+	sqe->user_data = data;
+}
+
+
+/* prep_uring_rename ********************
+   IORING_OP_RENAMEAT (Linux 5.11ȍ~)
+   Ή̃J[lł-EINVALŊ
+****************************************/
+void prep_uring_rename(struct io_uring_sqe *sqe, const char *oldpath, const char *newpath, unsigned long long data) {
+	sqe->opcode = IORING_OP_RENAMEAT;
+	sqe->fd = AT_FDCWD;
+	sqe->addr = (unsigned long)oldpath;
+	sqe->len = AT_FDCWD;
+	sqe->addr2 = (unsigned long)newpath;
+	sqe->user_data = data;
+}
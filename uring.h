@@ -0,0 +1,56 @@
+/*
+  F
+    io_uring̍ŏ̃bp[ (liburing͎gȂ)
+    O̍쐬ASQE̎擾ƏAsubmitACQE̎擾̂
+
+  쐬ҁ@@Fgbm
+*/
+#ifndef URING_H
+#define URING_H
+
+#include <sys/types.h>
+#include <linux/io_uring.h>
+
+/****************************************************/
+/*                      struct                      */
+/****************************************************/
+
+/* ID3uring *****************************
+   mmapSQ/CQO
+****************************************/
+typedef struct id3uring{
+	int fd;
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_ptr;
+	void *cq_ptr;
+	size_t sq_len;
+	size_t cq_len;
+	unsigned int sq_entries;
+	unsigned int sq_pending;    // ς݂ŖsubmitSQE
+}ID3URING;
+
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+int init_uring(ID3URING *ring, unsigned int entries);
+int probe_uring_op(ID3URING *ring, int op);
+void exit_uring(ID3URING *ring);
+struct io_uring_sqe *get_uring_sqe(ID3URING *ring);
+int submit_uring(ID3URING *ring, unsigned int wait);
+struct io_uring_cqe *peek_uring_cqe(ID3URING *ring);
+void seen_uring_cqe(ID3URING *ring);
+
+void prep_uring_rw(struct io_uring_sqe *sqe, int op, int fd, void *buf, unsigned int len, off_t off, unsigned long long data);
+void prep_uring_fsync(struct io_uring_sqe *sqe, int fd, unsigned long long data);
+void prep_uring_rename(struct io_uring_sqe *sqe, const char *oldpath, const char *newpath, unsigned long long data);
+
+#endif
@@ -0,0 +1,379 @@
+/*
+  F
+    opt [--watch DIR] inotifybp[
+    Eopen_id3_watchDIRȉ̑SfBNgĎ
+      (ォ쐬EړĂfBNgĎɉA
+       Ɋɂt@C͐Vt@CƂĈ)
+    Eread_id3_watchŃCxgǂ݁Afilterʂt@C
+      o҂̈ꗗɓBt@C̃Cxg
+      ҂Ԃ΂(debounce)
+    Etake_id3_watchő҂Ԃ߂o
+      ꗗmaxɒB҂ɌÂoA
+      ܂ł̓Cxgǂ܂Ȃ (J[l̃L[Ɏc)
+    EL[ꂽꍇ(IN_Q_OVERFLOW)overflow𗧂Ă̂ŁA
+      ĂяoDIRŜT
+
+  쐬ҁ@@Fgbm
+*/
+
+
+/****************************************************/
+/*                     include                      */
+/****************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "watch.h"
+
+
+
+/****************************************************/
+/*                      define                      */
+/****************************************************/
+#define RET_OK 0
+#define RET_ERROR -1
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR)
+#define WATCH_BUF_SIZE (64 * 1024)   // 1readœǂރCxg
+#define WATCH_DIR_INIT 64
+#define WATCH_FILE_INIT 64
+
+
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+static double now_id3_watch(void);
+static ID3WATCHDIR *find_id3_watch_dir(ID3WATCH *w, int wd);
+static int add_id3_watch_dir(ID3WATCH *w, const char *path, int top, int queue);
+static void remove_id3_watch_dir(ID3WATCH *w, int wd);
+static int add_id3_watch_file(ID3WATCH *w, char *path);
+static char *join_id3_watch_path(const char *dir, const char *name);
+
+
+
+/****************************************************/
+/*                    Process                       */
+/****************************************************/
+
+/* open_id3_watch ***********************
+   pathȉ̑SfBNg̊Ďn߂
+   (ɂt@C͎oȂ)
+   delay: Ō̃Cxgo܂łms
+   max: o҂̏
+   ߂lF(F0@sF-1)
+****************************************/
+int open_id3_watch(ID3WATCH *w, const char *path, unsigned int delay, size_t max, WATCHFILTER filter) {
+	memset(w, 0, sizeof(*w));
+	w->fd = -1;
+	w->delay = delay / 1000.0;
+	w->filemax = (max > 0) ? max : 1;
+	w->filter = filter;
+
+	w->buf = malloc(WATCH_BUF_SIZE);
+	if (w->buf == NULL) return RET_ERROR;
+	w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (w->fd < 0) goto OPEN_ID3_WATCH_ERROR;
+	if (add_id3_watch_dir(w, path, 1, 0)) goto OPEN_ID3_WATCH_ERROR;
+
+	return RET_OK;
+
+  OPEN_ID3_WATCH_ERROR:
+	close_id3_watch(w);
+	return RET_ERROR;
+}
+
+
+/* read_id3_watch ***********************
+   ͂ĂCxgSēǂ (҂Ȃ)
+   o҂maxɒBc͎ɉ
+   ߂lF(F0@sF-1)
+****************************************/
+int read_id3_watch(ID3WATCH *w) {
+	const struct inotify_event *ev;
+	ID3WATCHDIR *dir;
+	char *path;
+	ssize_t len;
+
+	while (w->filenum < w->filemax) {
+		if (w->bufpos >= w->buflen) {
+			len = read(w->fd, w->buf, WATCH_BUF_SIZE);
+			if (len < 0) return ((errno == EAGAIN) || (errno == EINTR)) ? RET_OK : RET_ERROR;
+			w->bufpos = 0;
+			w->buflen = len;
+			if (len == 0) return RET_OK;
+		}
+		ev = (const struct inotify_event *)(w->buf + w->bufpos);
+		w->bufpos += sizeof(struct inotify_event) + ev->len;
+
+		// 肱ڂfBNgĎ
+		if (ev->mask & IN_Q_OVERFLOW) {
+			w->overflow = 1;
+			if ((w->dirnum > 0) && add_id3_watch_dir(w, w->dir[0].path, 1, 0)) return RET_ERROR;
+			continue;
+		}
+		if (ev->mask & IN_IGNORED) {
+			remove_id3_watch_dir(w, ev->wd);
+			continue;
+		}
+		if (ev->len == 0) continue;
+		dir = find_id3_watch_dir(w, ev->wd);
+		if (dir == NULL) continue;
+
+		if (ev->mask & IN_ISDIR) {
+			if (! (ev->mask & (IN_CREATE | IN_MOVED_TO))) continue;
+			path = join_id3_watch_path(dir->path, ev->name);
+			if (path == NULL) return RET_ERROR;
+			add_id3_watch_dir(w, path, 0, 1); // rŏĂĂ悢
+			free(path);
+			continue;
+		}
+		if (! (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) continue;
+		if ((w->filter != NULL) && !w->filter(ev->name)) continue;
+		path = join_id3_watch_path(dir->path, ev->name);
+		if ((path == NULL) || add_id3_watch_file(w, path)) return RET_ERROR;
+	}
+
+	return RET_OK;
+}
+
+
+/* get_id3_watch_timeout ****************
+   ߂lFɎo܂łms (polltimeout)
+           o҂-1
+****************************************/
+int get_id3_watch_timeout(const ID3WATCH *w) {
+	double wait;
+
+	if ((w->bufpos < w->buflen) || (w->filenum >= w->filemax)) return 0;
+	if (w->filenum == 0) return -1;
+
+	wait = w->file[0].due - now_id3_watch();
+	if (wait <= 0) return 0;
+	return (int)(wait * 1000) + 1;
+}
+
+
+/* take_id3_watch ***********************
+   ҂Ԃ߂t@C1o
+   all: 1łΑ҂ԂɊ֌WȂo
+   ߂lFt@Cpath (Ăяofree)
+           o镨NULL
+****************************************/
+char *take_id3_watch(ID3WATCH *w, int all) {
+	char *path;
+
+	if (w->filenum == 0) return NULL;
+	if (!all && (w->filenum < w->filemax) && (w->file[0].due > now_id3_watch())) return NULL;
+
+	path = w->file[0].path;
+	w->filenum--;
+	memmove(w->file, w->file + 1, sizeof(ID3WATCHFILE) * w->filenum);
+
+	return path;
+}
+
+
+/* close_id3_watch **********************
+   Ď~߁AoĂȂt@ĈĂ
+****************************************/
+void close_id3_watch(ID3WATCH *w) {
+	size_t i;
+
+	if (w->fd >= 0) close(w->fd);
+	for (i = 0; i < w->dirnum; i++) free(w->dir[i].path);
+	for (i = 0; i < w->filenum; i++) free(w->file[i].path);
+	free(w->dir);
+	free(w->file);
+	free(w->buf);
+	memset(w, 0, sizeof(*w));
+	w->fd = -1;
+}
+
+
+/* now_id3_watch ************************
+   ߂lFCLOCK_MONOTONIC̕b
+****************************************/
+static double now_id3_watch(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* find_id3_watch_dir *******************
+   wd̊Ď񕪒T
+   ߂lFȂNULL
+****************************************/
+static ID3WATCHDIR *find_id3_watch_dir(ID3WATCH *w, int wd) {
+	size_t lo = 0, hi = w->dirnum, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (w->dir[mid].wd == wd) return &(w->dir[mid]);
+		if (w->dir[mid].wd < wd) lo = mid + 1;
+		else hi = mid;
+	}
+	return NULL;
+}
+
+
+/* add_id3_watch_dir ********************
+   pathƂ̉̑SfBNgĎɉ
+   ɊĎĂ(ړĂꍇ)pathu
+   top: 1ł΃NH (R}hC̎w)
+   queue: 1łΒɂt@Co҂ɓ
+   ߂lF(F0@sF-1)
+****************************************/
+static int add_id3_watch_dir(ID3WATCH *w, const char *path, int top, int queue) {
+	ID3WATCHDIR *p;
+	DIR *dp;
+	struct dirent *ent;
+	struct stat st;
+	char *child;
+	size_t i;
+	int wd, ret = RET_OK;
+
+	wd = inotify_add_watch(w->fd, path, WATCH_MASK | (top ? 0 : IN_DONT_FOLLOW));
+	if (wd < 0) {
+		fprintf(stderr, "watch error : %s\n", path);
+		return RET_ERROR;
+	}
+
+	p = find_id3_watch_dir(w, wd);
+	if (p != NULL) {
+		if (strcmp(p->path, path)) {
+			child = strdup(path);
+			if (child == NULL) return RET_ERROR;
+			free(p->path);
+			p->path = child;
+		}
+	}
+	else {
+		if (w->dirnum == w->dircap) {
+			p = realloc(w->dir, sizeof(ID3WATCHDIR) * (w->dircap ? w->dircap * 2 : WATCH_DIR_INIT));
+			if (p == NULL) return RET_ERROR;
+			w->dir = p;
+			w->dircap = w->dircap ? w->dircap * 2 : WATCH_DIR_INIT;
+		}
+		// wd͑Ă̂Œʏ͖ɓ
+		for (i = w->dirnum; (i > 0) && (w->dir[i - 1].wd > wd); i--) w->dir[i] = w->dir[i - 1];
+		w->dir[i].wd = wd;
+		w->dir[i].path = strdup(path);
+		if (w->dir[i].path == NULL) {
+			memmove(w->dir + i, w->dir + i + 1, sizeof(ID3WATCHDIR) * (w->dirnum - i));
+			return RET_ERROR;
+		}
+		w->dirnum++;
+	}
+
+	// Ďn߂OɂłE
+	dp = opendir(path);
+	if (dp == NULL) return RET_OK;
+	while ((ent = readdir(dp)) != NULL) {
+		if ((0 == strcmp(ent->d_name, ".")) || (0 == strcmp(ent->d_name, ".."))) continue;
+		if ((ent->d_type != DT_REG) && (ent->d_type != DT_DIR) && (ent->d_type != DT_UNKNOWN)) continue;
+		if ((ent->d_type == DT_REG) && (!queue || ((w->filter != NULL) && !w->filter(ent->d_name)))) continue;
+
+		child = join_id3_watch_path(path, ent->d_name);
+		if (child == NULL) {
+			ret = RET_ERROR;
+			break;
+		}
+		if ((ent->d_type == DT_UNKNOWN) && (lstat(child, &st) || !(S_ISDIR(st.st_mode) || S_ISREG(st.st_mode)))) {
+			free(child);
+			continue;
+		}
+		if ((ent->d_type == DT_DIR) || ((ent->d_type == DT_UNKNOWN) && S_ISDIR(st.st_mode))) {
+			if (add_id3_watch_dir(w, child, 0, queue)) ret = RET_ERROR;
+			free(child);
+			continue;
+		}
+		if (!queue || ((w->filter != NULL) && !w->filter(ent->d_name))) {
+			free(child);
+			continue;
+		}
+		if (add_id3_watch_file(w, child)) {
+			ret = RET_ERROR;
+			break;
+		}
+	}
+	closedir(dp);
+
+	return ret;
+}
+
+
+/* remove_id3_watch_dir *****************
+   fBNg̊Ďꗗ珜
+****************************************/
+static void remove_id3_watch_dir(ID3WATCH *w, int wd) {
+	ID3WATCHDIR *p = find_id3_watch_dir(w, wd);
+	size_t i;
+
+	if (p == NULL) return;
+	i = p - w->dir;
+	free(p->path);
+	w->dirnum--;
+	memmove(w->dir + i, w->dir + i + 1, sizeof(ID3WATCHDIR) * (w->dirnum - i));
+}
+
+
+/* add_id3_watch_file *******************
+   patho҂̖ɓ
+   ɂΑO̕ (҂Ԃ΂)
+   path: malloc (sꍇfree)
+   ߂lF(F0@sF-1)
+****************************************/
+static int add_id3_watch_file(ID3WATCH *w, char *path) {
+	ID3WATCHFILE *p;
+	size_t i, cap;
+
+	for (i = 0; i < w->filenum; i++) {
+		if (strcmp(w->file[i].path, path)) continue;
+		free(w->file[i].path);
+		w->filenum--;
+		memmove(w->file + i, w->file + i + 1, sizeof(ID3WATCHFILE) * (w->filenum - i));
+		break;
+	}
+
+	// VfBNg̒gmax𒴂ē邱Ƃ
+	if (w->filenum == w->filecap) {
+		cap = w->filecap ? w->filecap * 2 : WATCH_FILE_INIT;
+		p = realloc(w->file, sizeof(ID3WATCHFILE) * cap);
+		if (p == NULL) {
+			free(path);
+			return RET_ERROR;
+		}
+		w->file = p;
+		w->filecap = cap;
+	}
+
+	w->file[w->filenum].path = path;
+	w->file[w->filenum].due = now_id3_watch() + w->delay;
+	w->filenum++;
+
+	return RET_OK;
+}
+
+
+/* join_id3_watch_path ******************
+   ߂lFdir/name malloc (sNULL)
+****************************************/
+static char *join_id3_watch_path(const char *dir, const char *name) {
+	size_t len = strlen(dir);
+	char *path;
+
+	path = malloc(len + 1 + strlen(name) + 1);
+	if (path == NULL) return NULL;
+	sprintf(path, "%s%s%s", dir, (len > 0 && dir[len - 1] == '/') ? "" : "/", name);
+
+	return path;
+}
@@ -0,0 +1,70 @@
+/*
+  F
+    opt [--watch DIR] inotifybp[
+    fBNgċAIɊĎAI(IN_CLOSE_WRITE)
+    ړĂ(IN_MOVED_TO)t@C莞Ԃ܂Ƃ߂Ăo
+
+  쐬ҁ@@Fgbm
+*/
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stddef.h>
+
+/****************************************************/
+/*                      struct                      */
+/****************************************************/
+
+// name: t@C (ΏۂɂȂ1Ԃ)
+typedef int (*WATCHFILTER)(const char *name);
+
+
+/* ID3watchdir **************************
+   Ď̃fBNg (wd̏)
+****************************************/
+typedef struct id3watchdir{
+	int wd;
+	char *path;
+}ID3WATCHDIR;
+
+
+/* ID3watchfile *************************
+   o҂̃t@C (duȅ)
+****************************************/
+typedef struct id3watchfile{
+	char *path;
+	double due;                // ȍ~Ɏo (bACLOCK_MONOTONIC)
+}ID3WATCHFILE;
+
+
+/* ID3watch *****************************
+   inotifyfdƊĎEo҂̈ꗗ
+****************************************/
+typedef struct id3watch{
+	int fd;
+	ID3WATCHDIR *dir;
+	size_t dirnum;
+	size_t dircap;
+	ID3WATCHFILE *file;
+	size_t filenum;
+	size_t filecap;
+	size_t filemax;            // ȏ͑҂ɌÂo
+	double delay;              // Ō̃Cxgo܂ł̕b
+	WATCHFILTER filter;
+	unsigned char *buf;        // ǂ񂾃Cxg̎c
+	size_t bufpos;
+	size_t buflen;
+	int overflow;              // Cxg肱ڂ (ĂяoőŜT)
+}ID3WATCH;
+
+
+/****************************************************/
+/*                   prototype                      */
+/****************************************************/
+int open_id3_watch(ID3WATCH *w, const char *path, unsigned int delay, size_t max, WATCHFILTER filter);
+int read_id3_watch(ID3WATCH *w);
+int get_id3_watch_timeout(const ID3WATCH *w);
+char *take_id3_watch(ID3WATCH *w, int all);
+void close_id3_watch(ID3WATCH *w);
+
+#endif